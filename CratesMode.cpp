@@ -9,7 +9,9 @@
 #include "data_path.hpp" //helper to get paths relative to executable
 #include "compile_program.hpp" //helper to compile opengl shader programs
 #include "draw_text.hpp" //helper to... um.. draw text
-#include "vertex_color_program.hpp"
+#include "ShaderVariants.hpp"
+#include "GLState.hpp"
+#include "DynamicResolution.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
@@ -19,18 +21,22 @@
 #include <cstddef>
 #include <random>
 
-Load< MeshBuffer > crates_meshes(LoadTagDefault, [](){
+Load< MeshBuffer > crates_meshes(LoadTagInit, [](){
 	return new MeshBuffer(data_path("crates.pnc"));
 });
 
-Load< GLuint > crates_meshes_for_vertex_color_program(LoadTagDefault, [](){
-	return new GLuint(crates_meshes->make_vao_for_program(vertex_color_program->program));
+Load< ShaderVariants::Program > crates_program(LoadTagShaders, [](){
+	return ShaderVariants::load(0); //(no extra features)
 });
 
-Load< Sound::Sample > sample_dot(LoadTagDefault, [](){
+Load< GLuint > crates_meshes_for_crates_program(LoadTagDefault, [](){
+	return new GLuint(crates_meshes->make_vao_for_program(crates_program->program));
+});
+
+Load< Sound::Sample > sample_dot(LoadTagInit, [](){
 	return new Sound::Sample(data_path("dot.wav"));
 });
-Load< Sound::Sample > sample_loop(LoadTagDefault, [](){
+Load< Sound::Sample > sample_loop(LoadTagInit, [](){
 	return new Sound::Sample(data_path("loop.wav"));
 });
 
@@ -41,11 +47,8 @@ CratesMode::CratesMode() {
 
 	auto attach_object = [this](Scene::Transform *transform, std::string const &name) {
 		Scene::Object *object = scene.new_object(transform);
-		object->program = vertex_color_program->program;
-		object->program_mvp_mat4 = vertex_color_program->object_to_clip_mat4;
-		object->program_mv_mat4x3 = vertex_color_program->object_to_light_mat4x3;
-		object->program_itmv_mat3 = vertex_color_program->normal_to_light_mat3;
-		object->vao = *crates_meshes_for_vertex_color_program;
+		object->variant = crates_program->key;
+		object->vao = *crates_meshes_for_crates_program;
 		MeshBuffer::Mesh const &mesh = crates_meshes->lookup(name);
 		object->start = mesh.start;
 		object->count = mesh.count;
@@ -63,6 +66,10 @@ CratesMode::CratesMode() {
 		transform2->position = glm::vec3(0.0f, 0.0f, 1.5f);
 		transform2->scale = glm::vec3(0.5f);
 		small_crate = attach_object(transform2, "Crate");
+		Material tinted;
+		tinted.tint = glm::vec4(1.0f, 0.55f, 0.3f, 1.0f);
+		small_crate_material = Materials::create(tinted);
+		small_crate->material = small_crate_material;
 	}
 
 	{ //Camera looking at the origin:
@@ -79,6 +86,7 @@ CratesMode::CratesMode() {
 
 CratesMode::~CratesMode() {
 	if (loop) loop->stop();
+	Materials::destroy(small_crate_material);
 }
 
 bool CratesMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size) {
@@ -144,6 +152,9 @@ void CratesMode::update(float elapsed) {
 	if (controls.backward) camera->transform->position += amt * directions[2];
 	if (controls.forward) camera->transform->position -= amt * directions[2];
 
+	//(world matrices are computed for every transform at once; the camera just moved, so do that before looking them up)
+	scene.update_transforms();
+
 	{ //set sound positions:
 		glm::mat4 cam_to_world = camera->transform->make_local_to_world();
 		Sound::listener.set_position( cam_to_world[3] );
@@ -166,26 +177,28 @@ void CratesMode::update(float elapsed) {
 
 void CratesMode::draw(glm::uvec2 const &drawable_size) {
 	//set up basic OpenGL state:
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_BLEND);
-	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::enable(GL_DEPTH_TEST);
+	GLState::enable(GL_BLEND);
+	GLState::blend_equation(GL_FUNC_ADD);
+	GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	//set up light position + color:
-	glUseProgram(vertex_color_program->program);
-	glUniform3fv(vertex_color_program->sun_color_vec3, 1, glm::value_ptr(glm::vec3(0.81f, 0.81f, 0.76f)));
-	glUniform3fv(vertex_color_program->sun_direction_vec3, 1, glm::value_ptr(glm::normalize(glm::vec3(-0.2f, 0.2f, 1.0f))));
-	glUniform3fv(vertex_color_program->sky_color_vec3, 1, glm::value_ptr(glm::vec3(0.4f, 0.4f, 0.45f)));
-	glUniform3fv(vertex_color_program->sky_direction_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 1.0f, 0.0f)));
-	glUseProgram(0);
+	GLState::use_program(crates_program->program);
+	GLState::uniform(crates_program->sun_color_vec3, glm::vec3(0.81f, 0.81f, 0.76f));
+	GLState::uniform(crates_program->sun_direction_vec3, glm::normalize(glm::vec3(-0.2f, 0.2f, 1.0f)));
+	GLState::uniform(crates_program->sky_color_vec3, glm::vec3(0.4f, 0.4f, 0.45f));
+	GLState::uniform(crates_program->sky_direction_vec3, glm::vec3(0.0f, 1.0f, 0.0f));
 
 	//fix aspect ratio of camera
 	camera->aspect = drawable_size.x / float(drawable_size.y);
 
-	scene.draw(camera);
+	//the scene may be drawn at reduced resolution (text below is always drawn at full resolution):
+	DynamicResolution::draw_scene(drawable_size, [this](){
+		scene.draw(camera);
+	});
 
 	if (Mode::current.get() == this) {
-		glDisable(GL_DEPTH_TEST);
+		GLState::disable(GL_DEPTH_TEST);
 		std::string message;
 		if (mouse_captured) {
 			message = "ESCAPE TO UNGRAB MOUSE * WASD MOVE";
@@ -196,8 +209,6 @@ void CratesMode::draw(glm::uvec2 const &drawable_size) {
 		float width = text_width(message, height);
 		//draw_text(message, glm::vec2(-0.5f * width,-0.99f), height, glm::vec4(0.0f, 0.0f, 0.0f, 0.5f));
 		draw_text(message, glm::vec2(-0.5f * width,-1.0f), height, glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
-
-		glUseProgram(0);
 	}
 
 	GL_ERRORS();
@@ -209,6 +220,7 @@ void CratesMode::show_pause_menu() {
 
 	std::shared_ptr< Mode > game = shared_from_this();
 	menu->background = game;
+	menu->background_time_scale = 0.0f; //(paused; this also keeps the cached background accurate)
 
 	menu->choices.emplace_back("PAUSED");
 	menu->choices.emplace_back("RESUME", [game](){
@@ -6,6 +6,7 @@
 #include "GL.hpp"
 #include "Scene.hpp"
 #include "Sound.hpp"
+#include "Materials.hpp"
 
 #include <SDL.h>
 #include <glm/glm.hpp>
@@ -48,6 +49,9 @@ struct CratesMode : public Mode {
 	Scene::Object *large_crate = nullptr;
 	Scene::Object *small_crate = nullptr;
 
+	//the small crate is drawn with its own (tinted) material:
+	Materials::ID small_crate_material = Materials::Default;
+
 	//when this reaches zero, the 'dot' sample is triggered at the small crate:
 	float dot_countdown = 1.0f;
 
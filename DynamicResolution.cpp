@@ -0,0 +1,109 @@
+#include "DynamicResolution.hpp"
+
+#include "GLState.hpp"
+#include "FrameGraph.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace DynamicResolution {
+
+Settings settings;
+
+namespace {
+//local data:
+
+float current_scale = 1.0f;
+float smoothed_ms = 0.0f;
+uint32_t frames_since_change = 0;
+
+} //end anon namespace
+
+//------------------
+
+void draw_scene(glm::uvec2 const &drawable_size, std::function< void() > const &draw) {
+	if (!settings.enabled || drawable_size.x == 0 || drawable_size.y == 0) {
+		draw();
+		return;
+	}
+
+	current_scale = std::max(settings.min_scale, std::min(settings.max_scale, current_scale));
+	glm::uvec2 scene_size = glm::uvec2(
+		std::max(1U, uint32_t(std::round(drawable_size.x * current_scale))),
+		std::max(1U, uint32_t(std::round(drawable_size.y * current_scale)))
+	);
+	scene_size = glm::min(scene_size, drawable_size);
+	if (scene_size == drawable_size) { //full resolution: draw directly, skipping the copy
+		draw();
+		return;
+	}
+
+	GLint target_framebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target_framebuffer);
+
+	//the offscreen target is allocated at the drawable size (so it doesn't change with the scale);
+	// scaled rendering uses its lower-left corner:
+	FrameGraph graph;
+	FrameGraph::Resource target = graph.import_framebuffer("target", GLuint(target_framebuffer), drawable_size);
+	FrameGraph::Resource color = graph.create_texture("scene color", FrameGraph::TextureDesc(drawable_size, GL_RGBA8));
+	FrameGraph::Resource depth = graph.create_texture("scene depth", FrameGraph::TextureDesc(drawable_size, GL_DEPTH24_STENCIL8));
+
+	graph.add_pass("DynamicResolution scene", [&](FrameGraph::Builder &pass){
+		pass.write(color);
+		pass.write(depth);
+	}, [&](FrameGraph const &){
+		GLState::viewport(0, 0, scene_size.x, scene_size.y);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); //(uses whatever clear color main() set)
+		draw();
+	});
+
+	graph.add_pass("DynamicResolution upscale", [&](FrameGraph::Builder &pass){
+		pass.read(color);
+		pass.write(target);
+	}, [&](FrameGraph const &graph){
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, graph.read_framebuffer(color));
+		glBlitFramebuffer(
+			0, 0, scene_size.x, scene_size.y,
+			0, 0, drawable_size.x, drawable_size.y,
+			GL_COLOR_BUFFER_BIT, GL_LINEAR
+		);
+	});
+
+	if (!graph.execute()) {
+		std::cerr << "WARNING: dynamic resolution target is unavailable; disabling dynamic resolution." << std::endl;
+		settings.enabled = false;
+		draw();
+	}
+}
+
+void frame_finished(float cpu_ms, float gpu_ms) {
+	if (!settings.enabled) return;
+
+	float ms = (gpu_ms > 0.0f ? gpu_ms : cpu_ms);
+	//exponential moving average, so single slow frames don't cause a change:
+	smoothed_ms = (smoothed_ms == 0.0f ? ms : 0.9f * smoothed_ms + 0.1f * ms);
+
+	frames_since_change += 1;
+	if (frames_since_change < settings.settle_frames) return;
+
+	float old_scale = current_scale;
+	if (smoothed_ms > settings.target_ms * (1.0f + settings.hysteresis)) {
+		//frame cost is roughly proportional to pixel count (scale squared), so jump close to the budget:
+		current_scale *= std::max(0.75f, std::sqrt(settings.target_ms / smoothed_ms));
+	} else if (smoothed_ms < settings.target_ms * (1.0f - settings.hysteresis)) {
+		//creep back up slowly:
+		current_scale += 0.05f;
+	}
+	current_scale = std::max(settings.min_scale, std::min(settings.max_scale, current_scale));
+
+	if (current_scale != old_scale) {
+		frames_since_change = 0;
+	}
+}
+
+float scale() {
+	return current_scale;
+}
+
+} //namespace DynamicResolution
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+
+//DynamicResolution renders scenes at a reduced resolution when frames run over budget.
+// Modes draw their scenes through draw_scene(), which (when scaled) runs the drawing as a FrameGraph
+// pass into an offscreen color+depth target scaled by scale(), followed by a pass that upscales the
+// result into the framebuffer that was bound before. Anything drawn after draw_scene() (text, menus)
+// is drawn at native resolution.
+//
+//main() reports each frame's time with frame_finished(), and the scale is adjusted so that the
+// frame time stays near settings.target_ms.
+//
+//When not enabled (or at full scale), draw_scene() just calls 'draw'.
+//Note: the depth buffer of the target framebuffer isn't written by the scene when scaled.
+
+namespace DynamicResolution {
+
+struct Settings {
+	bool enabled = false;
+	float min_scale = 0.5f; //smallest fraction of drawable size (per axis) to render at
+	float max_scale = 1.0f; //largest fraction of drawable size (per axis) to render at
+	float target_ms = 15.0f; //frame time to aim for (a bit under a 60Hz frame)
+	float hysteresis = 0.1f; //scale only changes when frame time is outside target_ms * (1 +/- hysteresis)
+	uint32_t settle_frames = 15; //frames to wait after a change before changing again (timings arrive late)
+};
+extern Settings settings;
+
+void draw_scene(glm::uvec2 const &drawable_size, std::function< void() > const &draw);
+
+//report the time taken by the last frame:
+// gpu_ms is used if non-zero (it is what the resolution affects), otherwise cpu_ms is used.
+void frame_finished(float cpu_ms, float gpu_ms);
+
+//current per-axis scale factor:
+float scale();
+
+} //namespace DynamicResolution
@@ -0,0 +1,467 @@
+#include "FrameGraph.hpp"
+
+#include "GLState.hpp"
+#include "GPUProfiler.hpp"
+
+#include <map>
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <string>
+#include <cassert>
+
+namespace {
+	//GL textures handed out to transient resources, shared by all graphs:
+	struct PooledTexture {
+		FrameGraph::TextureDesc desc;
+		GLuint texture = 0;
+		bool in_use = false; //by a graph that is executing
+		uint32_t idle_frames = 0; //end_frame() calls since last used
+	};
+	std::vector< PooledTexture > &get_pool() {
+		static std::vector< PooledTexture > pool;
+		return pool;
+	}
+
+	//framebuffers, by attached textures (in attachment order):
+	std::map< std::vector< GLuint >, GLuint > &get_framebuffers() {
+		static std::map< std::vector< GLuint >, GLuint > framebuffers;
+		return framebuffers;
+	}
+
+	bool is_depth(GLenum format) {
+		return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32
+			|| format == GL_DEPTH_COMPONENT32F || format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+	}
+	bool has_stencil(GLenum format) {
+		return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+	}
+
+	GLuint make_texture(FrameGraph::TextureDesc const &desc) {
+		//(the format and type only matter for uploading data, but must be compatible with the internal format)
+		GLenum format = GL_RGBA;
+		GLenum type = GL_UNSIGNED_BYTE;
+		if (desc.format == GL_DEPTH24_STENCIL8) {
+			format = GL_DEPTH_STENCIL;
+			type = GL_UNSIGNED_INT_24_8;
+		} else if (desc.format == GL_DEPTH32F_STENCIL8) {
+			format = GL_DEPTH_STENCIL;
+			type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV;
+		} else if (is_depth(desc.format)) {
+			format = GL_DEPTH_COMPONENT;
+			type = GL_FLOAT;
+		}
+		GLint filter = (is_depth(desc.format) ? GL_NEAREST : GL_LINEAR);
+
+		GLuint texture = 0;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, desc.format, desc.size.x, desc.size.y, 0, format, type, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return texture;
+	}
+
+	//(cached) framebuffer with textures attached -- color formats to color attachments in order,
+	// depth formats to the depth attachment -- or 0 if that isn't complete:
+	GLuint framebuffer_for(std::vector< std::pair< GLuint, GLenum > > const &attachments) {
+		std::vector< GLuint > key;
+		key.reserve(attachments.size());
+		for (auto const &attachment : attachments) {
+			key.emplace_back(attachment.first);
+		}
+		auto &framebuffers = get_framebuffers();
+		auto f = framebuffers.find(key);
+		if (f != framebuffers.end()) return f->second;
+
+		//(this may be called in the middle of a pass, so leave the current bindings as they were)
+		GLint previous_draw = 0;
+		GLint previous_read = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_draw);
+		glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous_read);
+
+		GLuint framebuffer = 0;
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		std::vector< GLenum > draw_buffers;
+		for (auto const &attachment : attachments) {
+			GLenum point;
+			if (is_depth(attachment.second)) {
+				point = (has_stencil(attachment.second) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT);
+			} else {
+				point = GL_COLOR_ATTACHMENT0 + GLenum(draw_buffers.size());
+				draw_buffers.emplace_back(point);
+			}
+			glFramebufferTexture2D(GL_FRAMEBUFFER, point, GL_TEXTURE_2D, attachment.first, 0);
+		}
+		if (draw_buffers.empty()) {
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+		} else {
+			glDrawBuffers(GLsizei(draw_buffers.size()), draw_buffers.data());
+		}
+		bool complete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous_draw);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, previous_read);
+
+		if (!complete) {
+			glDeleteFramebuffers(1, &framebuffer);
+			return 0;
+		}
+		framebuffers.insert(std::make_pair(key, framebuffer));
+		return framebuffer;
+	}
+}
+
+//------------------
+
+FrameGraph::Resource FrameGraph::create_texture(char const *name, TextureDesc const &desc) {
+	if (desc.size.x == 0 || desc.size.y == 0) {
+		throw std::runtime_error("FrameGraph texture '" + std::string(name) + "' has zero size.");
+	}
+	resources.emplace_back();
+	resources.back().name = name;
+	resources.back().desc = desc;
+	resources.back().kind = ResourceInfo::Transient;
+	return Resource(resources.size() - 1);
+}
+
+FrameGraph::Resource FrameGraph::import_texture(char const *name, GLuint texture, TextureDesc const &desc) {
+	resources.emplace_back();
+	resources.back().name = name;
+	resources.back().desc = desc;
+	resources.back().kind = ResourceInfo::ImportedTexture;
+	resources.back().texture = texture;
+	return Resource(resources.size() - 1);
+}
+
+FrameGraph::Resource FrameGraph::import_framebuffer(char const *name, GLuint framebuffer, glm::uvec2 const &size) {
+	resources.emplace_back();
+	resources.back().name = name;
+	resources.back().desc.size = size;
+	resources.back().kind = ResourceInfo::ImportedFramebuffer;
+	resources.back().framebuffer = framebuffer;
+	return Resource(resources.size() - 1);
+}
+
+void FrameGraph::Builder::read(Resource resource) {
+	assert(resource < graph.resources.size() && "Reading a resource that doesn't exist.");
+	ResourceInfo &info = graph.resources[resource];
+	PassInfo &pass_info = graph.passes[pass];
+	if (info.kind == ResourceInfo::ImportedFramebuffer) {
+		throw std::runtime_error("FrameGraph pass '" + std::string(pass_info.name) + "' reads framebuffer '" + info.name + "' (only textures can be read).");
+	}
+	if (std::find(pass_info.writes.begin(), pass_info.writes.end(), resource) != pass_info.writes.end()) {
+		throw std::runtime_error("FrameGraph pass '" + std::string(pass_info.name) + "' both reads and writes '" + info.name + "'.");
+	}
+	if (std::find(pass_info.reads.begin(), pass_info.reads.end(), resource) != pass_info.reads.end()) return;
+	pass_info.reads.emplace_back(resource);
+	info.readers.emplace_back(pass);
+}
+
+void FrameGraph::Builder::write(Resource resource) {
+	assert(resource < graph.resources.size() && "Writing a resource that doesn't exist.");
+	ResourceInfo &info = graph.resources[resource];
+	PassInfo &pass_info = graph.passes[pass];
+	if (std::find(pass_info.reads.begin(), pass_info.reads.end(), resource) != pass_info.reads.end()) {
+		throw std::runtime_error("FrameGraph pass '" + std::string(pass_info.name) + "' both reads and writes '" + info.name + "'.");
+	}
+	if (std::find(pass_info.writes.begin(), pass_info.writes.end(), resource) != pass_info.writes.end()) return;
+	pass_info.writes.emplace_back(resource);
+	info.writers.emplace_back(pass);
+}
+
+void FrameGraph::Builder::keep() {
+	graph.passes[pass].keep = true;
+}
+
+void FrameGraph::add_pass(char const *name, std::function< void(Builder &) > const &setup, std::function< void(FrameGraph const &) > const &execute) {
+	passes.emplace_back();
+	passes.back().name = name;
+	passes.back().execute = execute;
+	Builder builder(*this, uint32_t(passes.size() - 1));
+	setup(builder);
+}
+
+void FrameGraph::cull() {
+	//imported resources are the graph's outputs; anything that doesn't lead to them is culled:
+	std::vector< uint32_t > todo;
+	auto make_live = [&](uint32_t p) {
+		if (passes[p].live) return;
+		passes[p].live = true;
+		todo.emplace_back(p);
+	};
+	for (auto &pass : passes) {
+		pass.live = false;
+	}
+	for (auto &resource : resources) {
+		resource.needed = (resource.kind != ResourceInfo::Transient);
+	}
+	for (uint32_t p = 0; p < passes.size(); ++p) {
+		if (passes[p].keep) make_live(p);
+	}
+	for (auto const &resource : resources) {
+		if (!resource.needed) continue;
+		for (uint32_t w : resource.writers) make_live(w);
+	}
+	while (!todo.empty()) {
+		uint32_t p = todo.back();
+		todo.pop_back();
+		for (Resource r : passes[p].reads) {
+			ResourceInfo &resource = resources[r];
+			if (resource.needed) continue;
+			resource.needed = true;
+			for (uint32_t w : resource.writers) make_live(w);
+		}
+	}
+}
+
+void FrameGraph::sort() {
+	//dependencies between live passes: writers of a resource run in the order they were added, then its readers:
+	std::vector< std::vector< uint32_t > > after(passes.size()); //pass -> passes that must wait for it
+	std::vector< uint32_t > waiting_on(passes.size(), 0);
+	auto add_edge = [&](uint32_t from, uint32_t to) {
+		after[from].emplace_back(to);
+		waiting_on[to] += 1;
+	};
+	for (auto const &resource : resources) {
+		uint32_t last_writer = -1U;
+		for (uint32_t w : resource.writers) {
+			if (!passes[w].live) continue;
+			if (last_writer != -1U) add_edge(last_writer, w);
+			last_writer = w;
+		}
+		for (uint32_t r : resource.readers) {
+			if (!passes[r].live) continue;
+			if (last_writer != -1U) {
+				add_edge(last_writer, r);
+			} else if (resource.kind == ResourceInfo::Transient) {
+				throw std::runtime_error("FrameGraph pass '" + std::string(passes[r].name) + "' reads '" + resource.name + "', which no pass writes.");
+			}
+		}
+	}
+
+	//topological sort, preferring passes added earlier when there is a choice:
+	order.clear();
+	std::vector< uint32_t > ready;
+	uint32_t live_count = 0;
+	for (uint32_t p = 0; p < passes.size(); ++p) {
+		if (!passes[p].live) continue;
+		live_count += 1;
+		if (waiting_on[p] == 0) ready.emplace_back(p);
+	}
+	while (!ready.empty()) {
+		auto next = std::min_element(ready.begin(), ready.end());
+		uint32_t p = *next;
+		ready.erase(next);
+		order.emplace_back(p);
+		for (uint32_t a : after[p]) {
+			waiting_on[a] -= 1;
+			if (waiting_on[a] == 0) ready.emplace_back(a);
+		}
+	}
+	if (order.size() != live_count) {
+		throw std::runtime_error("FrameGraph passes have a cyclic dependency.");
+	}
+}
+
+void FrameGraph::allocate() {
+	//lifetimes, in execution order:
+	for (auto &resource : resources) {
+		resource.first_use = -1U;
+		resource.last_use = 0;
+	}
+	for (uint32_t i = 0; i < order.size(); ++i) {
+		PassInfo const &pass = passes[order[i]];
+		for (auto const &list : { &pass.reads, &pass.writes }) {
+			for (Resource r : *list) {
+				resources[r].first_use = std::min(resources[r].first_use, i);
+				resources[r].last_use = std::max(resources[r].last_use, i);
+			}
+		}
+	}
+
+	std::vector< Resource > transients;
+	for (Resource r = 0; r < resources.size(); ++r) {
+		if (resources[r].kind == ResourceInfo::Transient && resources[r].first_use != -1U) transients.emplace_back(r);
+	}
+	std::stable_sort(transients.begin(), transients.end(), [this](Resource a, Resource b) {
+		return resources[a].first_use < resources[b].first_use;
+	});
+
+	//give each transient a texture no longer in use by an earlier transient, or a fresh one from the pool:
+	auto &pool = get_pool();
+	std::vector< uint32_t > free_after(acquired.size(), 0); //(acquired is empty here)
+	for (Resource r : transients) {
+		ResourceInfo &resource = resources[r];
+		uint32_t slot = -1U;
+		for (uint32_t s = 0; s < acquired.size(); ++s) {
+			if (free_after[s] < resource.first_use && pool[acquired[s]].desc == resource.desc) {
+				slot = s;
+				break;
+			}
+		}
+		if (slot == -1U) {
+			uint32_t index = -1U;
+			for (uint32_t i = 0; i < pool.size(); ++i) {
+				if (!pool[i].in_use && pool[i].desc == resource.desc) {
+					index = i;
+					break;
+				}
+			}
+			if (index == -1U) {
+				pool.emplace_back();
+				pool.back().desc = resource.desc;
+				pool.back().texture = make_texture(resource.desc);
+				index = uint32_t(pool.size() - 1);
+			}
+			pool[index].in_use = true;
+			pool[index].idle_frames = 0;
+			acquired.emplace_back(index);
+			free_after.emplace_back(0);
+			slot = uint32_t(acquired.size() - 1);
+		}
+		free_after[slot] = resource.last_use;
+		resource.texture = pool[acquired[slot]].texture;
+	}
+
+	transient_textures = uint32_t(transients.size());
+	pooled_textures = uint32_t(acquired.size());
+}
+
+void FrameGraph::release() {
+	auto &pool = get_pool();
+	for (uint32_t index : acquired) {
+		pool[index].in_use = false;
+	}
+	acquired.clear();
+}
+
+bool FrameGraph::bind_framebuffers() {
+	for (uint32_t p : order) {
+		PassInfo &pass = passes[p];
+		pass.framebuffer = 0;
+		if (pass.writes.empty()) continue;
+
+		glm::uvec2 size = resources[pass.writes[0]].desc.size;
+		std::vector< std::pair< GLuint, GLenum > > colors;
+		std::vector< std::pair< GLuint, GLenum > > depths;
+		for (Resource r : pass.writes) {
+			ResourceInfo const &resource = resources[r];
+			if (resource.kind == ResourceInfo::ImportedFramebuffer) {
+				if (pass.writes.size() != 1) {
+					throw std::runtime_error("FrameGraph pass '" + std::string(pass.name) + "' writes framebuffer '" + resource.name + "' and something else.");
+				}
+				pass.framebuffer = resource.framebuffer;
+				break;
+			}
+			if (resource.desc.size != size) {
+				throw std::runtime_error("FrameGraph pass '" + std::string(pass.name) + "' writes textures of different sizes.");
+			}
+			(is_depth(resource.desc.format) ? depths : colors).emplace_back(resource.texture, resource.desc.format);
+		}
+		if (resources[pass.writes[0]].kind == ResourceInfo::ImportedFramebuffer) continue;
+		if (depths.size() > 1) {
+			throw std::runtime_error("FrameGraph pass '" + std::string(pass.name) + "' writes more than one depth texture.");
+		}
+
+		colors.insert(colors.end(), depths.begin(), depths.end());
+		pass.framebuffer = framebuffer_for(colors);
+		if (pass.framebuffer == 0) {
+			std::cerr << "WARNING: FrameGraph pass '" << pass.name << "' framebuffer is incomplete." << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FrameGraph::execute() {
+	cull();
+	sort();
+	allocate();
+	if (!bind_framebuffers()) {
+		release();
+		return false;
+	}
+
+	passes_run = uint32_t(order.size());
+	passes_culled = uint32_t(passes.size() - order.size());
+
+	//passes bind their own targets; put back whatever was bound afterward:
+	GLint previous_framebuffer = 0;
+	GLint previous_viewport[4] = {0, 0, 0, 0};
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer);
+	glGetIntegerv(GL_VIEWPORT, previous_viewport);
+
+	for (uint32_t p : order) {
+		PassInfo const &pass = passes[p];
+		GPUProfiler::Scope profile(pass.name);
+		if (!pass.writes.empty()) {
+			glm::uvec2 size = resources[pass.writes[0]].desc.size;
+			glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+			GLState::viewport(0, 0, size.x, size.y);
+		}
+		pass.execute(*this);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer);
+	GLState::viewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+
+	release();
+	return true;
+}
+
+GLuint FrameGraph::texture(Resource resource) const {
+	assert(resource < resources.size() && "Looking up a resource that doesn't exist.");
+	assert(resources[resource].kind != ResourceInfo::ImportedFramebuffer && "Framebuffers aren't textures.");
+	return resources[resource].texture;
+}
+
+GLuint FrameGraph::read_framebuffer(Resource resource) const {
+	assert(resource < resources.size() && "Looking up a resource that doesn't exist.");
+	ResourceInfo const &info = resources[resource];
+	if (info.kind == ResourceInfo::ImportedFramebuffer) return info.framebuffer;
+	GLuint framebuffer = framebuffer_for({ std::make_pair(info.texture, info.desc.format) });
+	if (framebuffer == 0) {
+		throw std::runtime_error("FrameGraph texture '" + std::string(info.name) + "' can't be attached to a framebuffer.");
+	}
+	return framebuffer;
+}
+
+glm::uvec2 FrameGraph::size(Resource resource) const {
+	assert(resource < resources.size() && "Looking up a resource that doesn't exist.");
+	return resources[resource].desc.size;
+}
+
+void FrameGraph::end_frame() {
+	//free textures that haven't been used for a few frames (e.g. after the window was resized):
+	auto &pool = get_pool();
+	for (auto &pooled : pool) {
+		if (pooled.in_use) continue;
+		pooled.idle_frames += 1;
+		if (pooled.idle_frames > 2) {
+			forget_texture(pooled.texture);
+			glDeleteTextures(1, &pooled.texture);
+			pooled.texture = 0;
+		}
+	}
+	pool.erase(std::remove_if(pool.begin(), pool.end(), [](PooledTexture const &pooled) {
+		return pooled.texture == 0;
+	}), pool.end());
+}
+
+void FrameGraph::forget_texture(GLuint texture) {
+	auto &framebuffers = get_framebuffers();
+	for (auto f = framebuffers.begin(); f != framebuffers.end(); /* later */) {
+		if (std::find(f->first.begin(), f->first.end(), texture) != f->first.end()) {
+			glDeleteFramebuffers(1, &f->second);
+			f = framebuffers.erase(f);
+		} else {
+			++f;
+		}
+	}
+}
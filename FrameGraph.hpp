@@ -0,0 +1,129 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+//"FrameGraph" runs a set of render passes that declare which render targets they read and write,
+// instead of each feature binding framebuffers and allocating targets by hand.
+//
+//Usage (build a graph, execute it, and let it go):
+// FrameGraph graph;
+// FrameGraph::Resource screen = graph.import_framebuffer("screen", 0, drawable_size);
+// FrameGraph::Resource color = graph.create_texture("color", FrameGraph::TextureDesc(drawable_size, GL_RGBA8));
+// graph.add_pass("draw", [&](FrameGraph::Builder &pass){
+//     pass.write(color);
+// }, [&](FrameGraph const &graph){
+//     glClear(GL_COLOR_BUFFER_BIT); //(transient textures start with undefined contents)
+//     ...
+// });
+// graph.add_pass("post", [&](FrameGraph::Builder &pass){
+//     pass.read(color);
+//     pass.write(screen);
+// }, [&](FrameGraph const &graph){
+//     glBindTexture(GL_TEXTURE_2D, graph.texture(color));
+//     ...
+// });
+// graph.execute();
+//
+//execute():
+// - orders passes so that each resource's writers run (in the order they were added) before its readers;
+// - culls passes whose writes nobody reads (imported resources count as read, as do passes marked keep());
+// - gives each transient texture a pooled GL texture, sharing one texture between transients whose
+//   lifetimes (first to last use, in pass order) don't overlap; pooled textures are reused by
+//   later graphs, and freed by end_frame() once unused for a couple of frames;
+// - binds a framebuffer with each pass's written textures attached (color in the order written,
+//   depth formats as the depth attachment) and sets the viewport to their size before running it.
+//
+//Pass and resource names must be string literals (passes are profiled with GPUProfiler::Scope).
+
+struct FrameGraph {
+	typedef uint32_t Resource;
+
+	struct TextureDesc {
+		TextureDesc() = default;
+		TextureDesc(glm::uvec2 const &size_, GLenum format_) : size(size_), format(format_) { }
+		glm::uvec2 size = glm::uvec2(0);
+		GLenum format = GL_RGBA8; //sized internal format; depth (stencil) formats are depth attachments
+		bool operator==(TextureDesc const &o) const { return size == o.size && format == o.format; }
+	};
+
+	//a texture that only lives while the graph executes:
+	Resource create_texture(char const *name, TextureDesc const &desc);
+	//a texture owned by someone else (e.g. a cache that outlives the graph):
+	Resource import_texture(char const *name, GLuint texture, TextureDesc const &desc);
+	//an existing framebuffer (e.g. 0, the window); passes that write it may write nothing else:
+	Resource import_framebuffer(char const *name, GLuint framebuffer, glm::uvec2 const &size);
+
+	//passed to a pass's setup function to declare what the pass uses:
+	struct Builder {
+		void read(Resource resource);
+		void write(Resource resource);
+		void keep(); //never cull this pass (e.g. it has effects outside of the graph)
+		//internals:
+		Builder(FrameGraph &graph_, uint32_t pass_) : graph(graph_), pass(pass_) { }
+		FrameGraph &graph;
+		uint32_t pass;
+	};
+
+	//add a pass; 'setup' is called immediately, 'execute' is called from execute() (if the pass isn't culled):
+	void add_pass(char const *name, std::function< void(Builder &) > const &setup, std::function< void(FrameGraph const &) > const &execute);
+
+	//order, cull, allocate, and run passes, then restore the framebuffer binding and viewport:
+	// returns false (having warned and run nothing) if a pass's framebuffer is incomplete.
+	bool execute();
+
+	//GL texture for a texture resource (valid during execute()):
+	GLuint texture(Resource resource) const;
+	//a framebuffer with just this texture attached, for glBlitFramebuffer (valid during execute()):
+	GLuint read_framebuffer(Resource resource) const;
+	glm::uvec2 size(Resource resource) const;
+
+	//statistics from the last execute():
+	uint32_t passes_run = 0;
+	uint32_t passes_culled = 0;
+	uint32_t transient_textures = 0; //transient resources...
+	uint32_t pooled_textures = 0; //...and the GL textures they were given
+
+	//once per frame (after drawing), to free pooled textures that have gone unused:
+	static void end_frame();
+	//drop cached framebuffers that attach a texture (call before deleting an imported texture):
+	static void forget_texture(GLuint texture);
+
+	//internals:
+	struct ResourceInfo {
+		char const *name = "";
+		TextureDesc desc;
+		enum Kind : uint8_t { Transient, ImportedTexture, ImportedFramebuffer } kind = Transient;
+		GLuint texture = 0; //(transients: assigned during execute())
+		GLuint framebuffer = 0; //ImportedFramebuffer
+		std::vector< uint32_t > writers; //passes, in the order they were added
+		std::vector< uint32_t > readers;
+		bool needed = false; //read by a live pass, or imported
+		uint32_t first_use = -1U; //in execution order
+		uint32_t last_use = 0;
+	};
+	struct PassInfo {
+		char const *name = "";
+		std::vector< Resource > reads;
+		std::vector< Resource > writes;
+		bool keep = false;
+		bool live = false;
+		GLuint framebuffer = 0; //assigned during execute()
+		std::function< void(FrameGraph const &) > execute;
+	};
+	std::vector< ResourceInfo > resources;
+	std::vector< PassInfo > passes;
+	std::vector< uint32_t > order; //live passes in execution order
+	std::vector< uint32_t > acquired; //pooled textures held during execute()
+
+	void cull();
+	void sort();
+	void allocate(); //assigns transient textures
+	void release(); //returns transient textures to the pool
+	bool bind_framebuffers();
+};
@@ -0,0 +1,266 @@
+#include "GLState.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <unordered_map>
+#include <vector>
+#include <array>
+#include <cstring>
+
+namespace GLState {
+
+namespace {
+//local data:
+
+//sentinel for "not known"; OpenGL object names are never this large in practice:
+constexpr const GLuint Unknown = -1U;
+
+GLuint current_program = Unknown;
+GLuint current_vao = Unknown;
+
+struct BufferBinding {
+	GLenum target;
+	GLuint buffer;
+};
+std::array< BufferBinding, 5 > buffer_bindings = {{
+	{GL_ARRAY_BUFFER, Unknown},
+	{GL_UNIFORM_BUFFER, Unknown},
+	{GL_TEXTURE_BUFFER, Unknown},
+	{GL_COPY_READ_BUFFER, Unknown},
+	{GL_COPY_WRITE_BUFFER, Unknown},
+}};
+
+//indexed GL_UNIFORM_BUFFER bindings (as set by glBindBufferRange):
+struct RangeBinding {
+	GLuint buffer = Unknown;
+	GLintptr offset = 0;
+	GLsizeiptr size = 0;
+};
+std::array< RangeBinding, 16 > uniform_ranges;
+
+//enable bits (missing from the map == unknown):
+std::unordered_map< GLenum, bool > caps;
+
+GLenum blend_sfactor = Unknown;
+GLenum blend_dfactor = Unknown;
+GLenum blend_mode = Unknown;
+
+bool clear_color_known = false;
+glm::vec4 current_clear_color;
+
+bool viewport_known = false;
+GLint current_viewport[4] = {0, 0, 0, 0};
+
+//shadowed uniform values, indexed by [program][location]:
+struct UniformValue {
+	std::array< float, 16 > data;
+	uint32_t count = 0; //0 == unknown
+};
+std::unordered_map< GLuint, std::vector< UniformValue > > uniforms;
+
+Stats current_frame;
+Stats last_frame;
+
+inline bool issue() {
+	current_frame.issued += 1;
+	return true;
+}
+inline bool avoid() {
+	current_frame.avoided += 1;
+	return false;
+}
+
+//returns true (after updating the shadow copy) if the uniform value needs to be uploaded:
+bool uniform_changed(GLint location, float const *data, uint32_t count) {
+	if (location < 0) return false; //not active in program; nothing to do (and don't count it)
+	if (current_program == Unknown || current_program == 0) return issue(); //no tracked program; can't shadow
+	std::vector< UniformValue > &values = uniforms[current_program];
+	if (GLuint(location) >= values.size()) values.resize(location + 1);
+	UniformValue &value = values[location];
+	if (value.count == count && std::memcmp(value.data.data(), data, count * sizeof(float)) == 0) {
+		return avoid();
+	}
+	std::memcpy(value.data.data(), data, count * sizeof(float));
+	value.count = count;
+	return issue();
+}
+
+} //end anon namespace
+
+//------------------
+
+void use_program(GLuint program) {
+	if (program == current_program) { avoid(); return; }
+	issue();
+	glUseProgram(program);
+	current_program = program;
+}
+
+void bind_vertex_array(GLuint vao) {
+	if (vao == current_vao) { avoid(); return; }
+	issue();
+	glBindVertexArray(vao);
+	current_vao = vao;
+}
+
+void bind_buffer(GLenum target, GLuint buffer) {
+	for (auto &binding : buffer_bindings) {
+		if (binding.target != target) continue;
+		if (binding.buffer == buffer) { avoid(); return; }
+		issue();
+		glBindBuffer(target, buffer);
+		binding.buffer = buffer;
+		return;
+	}
+	//untracked target:
+	issue();
+	glBindBuffer(target, buffer);
+}
+
+void bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+	if (target == GL_UNIFORM_BUFFER && index < uniform_ranges.size()) {
+		RangeBinding &range = uniform_ranges[index];
+		if (range.buffer == buffer && range.offset == offset && range.size == size) { avoid(); return; }
+		range.buffer = buffer;
+		range.offset = offset;
+		range.size = size;
+	}
+	issue();
+	glBindBufferRange(target, index, buffer, offset, size);
+	//glBindBufferRange also binds the buffer to the generic binding point:
+	for (auto &binding : buffer_bindings) {
+		if (binding.target == target) binding.buffer = buffer;
+	}
+}
+
+void enable(GLenum cap) {
+	auto f = caps.find(cap);
+	if (f != caps.end() && f->second) { avoid(); return; }
+	issue();
+	glEnable(cap);
+	caps[cap] = true;
+}
+
+void disable(GLenum cap) {
+	auto f = caps.find(cap);
+	if (f != caps.end() && !f->second) { avoid(); return; }
+	issue();
+	glDisable(cap);
+	caps[cap] = false;
+}
+
+void blend_func(GLenum sfactor, GLenum dfactor) {
+	if (sfactor == blend_sfactor && dfactor == blend_dfactor) { avoid(); return; }
+	issue();
+	glBlendFunc(sfactor, dfactor);
+	blend_sfactor = sfactor;
+	blend_dfactor = dfactor;
+}
+
+void blend_equation(GLenum mode) {
+	if (mode == blend_mode) { avoid(); return; }
+	issue();
+	glBlendEquation(mode);
+	blend_mode = mode;
+}
+
+void clear_color(glm::vec4 const &color) {
+	if (clear_color_known && color == current_clear_color) { avoid(); return; }
+	issue();
+	glClearColor(color.x, color.y, color.z, color.w);
+	current_clear_color = color;
+	clear_color_known = true;
+}
+
+void viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+	if (viewport_known
+	 && current_viewport[0] == x && current_viewport[1] == y
+	 && current_viewport[2] == width && current_viewport[3] == height) {
+		avoid();
+		return;
+	}
+	issue();
+	glViewport(x, y, width, height);
+	current_viewport[0] = x;
+	current_viewport[1] = y;
+	current_viewport[2] = width;
+	current_viewport[3] = height;
+	viewport_known = true;
+}
+
+//------------------
+
+void uniform(GLint location, float value) {
+	if (uniform_changed(location, &value, 1)) glUniform1f(location, value);
+}
+
+void uniform(GLint location, glm::vec2 const &value) {
+	if (uniform_changed(location, glm::value_ptr(value), 2)) glUniform2fv(location, 1, glm::value_ptr(value));
+}
+
+void uniform(GLint location, glm::vec3 const &value) {
+	if (uniform_changed(location, glm::value_ptr(value), 3)) glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+void uniform(GLint location, glm::vec4 const &value) {
+	if (uniform_changed(location, glm::value_ptr(value), 4)) glUniform4fv(location, 1, glm::value_ptr(value));
+}
+
+void uniform(GLint location, glm::mat3 const &value) {
+	if (uniform_changed(location, glm::value_ptr(value), 9)) glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void uniform(GLint location, glm::mat4x3 const &value) {
+	if (uniform_changed(location, glm::value_ptr(value), 12)) glUniformMatrix4x3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void uniform(GLint location, glm::mat4 const &value) {
+	if (uniform_changed(location, glm::value_ptr(value), 16)) glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void forget_program(GLuint program) {
+	uniforms.erase(program);
+	if (current_program == program) current_program = Unknown;
+}
+
+void forget_buffer(GLuint buffer) {
+	for (auto &binding : buffer_bindings) {
+		if (binding.buffer == buffer) binding.buffer = Unknown;
+	}
+	for (auto &range : uniform_ranges) {
+		if (range.buffer == buffer) range.buffer = Unknown;
+	}
+}
+
+void invalidate() {
+	current_program = Unknown;
+	current_vao = Unknown;
+	for (auto &binding : buffer_bindings) {
+		binding.buffer = Unknown;
+	}
+	for (auto &range : uniform_ranges) {
+		range.buffer = Unknown;
+	}
+	caps.clear();
+	blend_sfactor = blend_dfactor = blend_mode = Unknown;
+	clear_color_known = false;
+	viewport_known = false;
+	uniforms.clear();
+}
+
+//------------------
+
+void begin_frame() {
+	last_frame = current_frame;
+	current_frame = Stats();
+}
+
+Stats const &frame_stats() {
+	return current_frame;
+}
+
+Stats const &last_frame_stats() {
+	return last_frame;
+}
+
+} //namespace GLState
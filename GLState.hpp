@@ -0,0 +1,62 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+//GLState shadows commonly-changed OpenGL state and skips calls that wouldn't change anything.
+// Modes and helpers should go through these functions (rather than, e.g., calling glUseProgram directly)
+// so that the shadow copy stays in sync with the context. There's no need to "unbind" things
+// (e.g. glUseProgram(0)) after drawing; the next user just binds what it needs.
+//If code outside GLState changes tracked state, call GLState::invalidate() afterward.
+
+namespace GLState {
+
+//---- bindings ----
+void use_program(GLuint program);
+void bind_vertex_array(GLuint vao);
+//tracked for GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_TEXTURE_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER;
+// (GL_ELEMENT_ARRAY_BUFFER is vertex array state, so it is passed through without tracking)
+void bind_buffer(GLenum target, GLuint buffer);
+//glBindBufferRange; indexed bindings are tracked for GL_UNIFORM_BUFFER (indices 0-15):
+void bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+//---- fixed-function state ----
+void enable(GLenum cap);
+void disable(GLenum cap);
+void blend_func(GLenum sfactor, GLenum dfactor);
+void blend_equation(GLenum mode);
+void clear_color(glm::vec4 const &color);
+void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+//---- uniforms ----
+//Values are remembered per (program, location), so these skip uploads of unchanged values.
+// They set uniforms on the current program (as set by use_program).
+void uniform(GLint location, float value);
+void uniform(GLint location, glm::vec2 const &value);
+void uniform(GLint location, glm::vec3 const &value);
+void uniform(GLint location, glm::vec4 const &value);
+void uniform(GLint location, glm::mat3 const &value);
+void uniform(GLint location, glm::mat4x3 const &value);
+void uniform(GLint location, glm::mat4 const &value);
+//uniforms are considered unknown (and always uploaded) after a program is relinked or deleted:
+void forget_program(GLuint program);
+
+//call when deleting a buffer (deleting a bound buffer unbinds it, and its name may be reused):
+void forget_buffer(GLuint buffer);
+
+//forget all shadowed state (next call of each kind will always reach OpenGL):
+void invalidate();
+
+//---- statistics ----
+struct Stats {
+	uint32_t issued = 0; //calls passed through to OpenGL
+	uint32_t avoided = 0; //redundant calls dropped
+};
+//call once per frame; resets the counters for the new frame:
+void begin_frame();
+//counters for the frame in progress and for the last complete frame:
+Stats const &frame_stats();
+Stats const &last_frame_stats();
+
+} //namespace GLState
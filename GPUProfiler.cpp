@@ -0,0 +1,358 @@
+#include "GPUProfiler.hpp"
+
+#include "GL.hpp"
+#include "GLState.hpp"
+#include "Load.hpp"
+#include "compile_program.hpp"
+#include "draw_text.hpp"
+#include "StreamBuffer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <cstddef>
+
+namespace GPUProfiler {
+
+bool enabled = true;
+
+namespace {
+//local data:
+
+//results for a frame are collected this many frames after they are issued:
+constexpr const uint32_t FrameLag = 4;
+//rolling window of samples kept per scope:
+constexpr const uint32_t Window = 120;
+
+struct ScopeInfo {
+	char const *name = nullptr;
+	uint32_t depth = 0;
+	std::array< float, Window > gpu_ms;
+	std::array< float, Window > cpu_ms;
+	uint32_t next = 0; //next slot to write
+	uint32_t count = 0; //filled slots
+};
+std::vector< ScopeInfo > scopes;
+
+struct Record {
+	uint32_t scope;
+	GLuint begin_query;
+	GLuint end_query;
+	float cpu_ms;
+};
+
+struct Frame {
+	std::vector< GLuint > queries; //reused from frame to frame
+	uint32_t used = 0;
+	std::vector< Record > records;
+	GLuint last_query = 0; //timestamps complete in order, so this one being ready means they all are
+	bool pending = false;
+};
+std::array< Frame, FrameLag > frames;
+uint32_t frame_index = 0;
+bool in_frame = false;
+
+struct Open {
+	uint32_t record;
+	std::chrono::high_resolution_clock::time_point start;
+};
+std::vector< Open > stack;
+
+uint32_t dropped = 0;
+
+//readout bar vertices are rebuilt every frame, so they live in a stream buffer (made on first draw_readout, freed in shutdown):
+StreamBuffer *readout_stream = nullptr;
+GLuint readout_vao = 0;
+
+uint32_t find_scope(char const *name, uint32_t depth) {
+	for (uint32_t i = 0; i < scopes.size(); ++i) {
+		if (scopes[i].name == name || std::strcmp(scopes[i].name, name) == 0) return i;
+	}
+	scopes.emplace_back();
+	scopes.back().name = name;
+	scopes.back().depth = depth;
+	return uint32_t(scopes.size() - 1);
+}
+
+GLuint next_query(Frame &frame) {
+	if (frame.used == frame.queries.size()) {
+		GLuint query = 0;
+		glGenQueries(1, &query);
+		frame.queries.emplace_back(query);
+	}
+	return frame.queries[frame.used++];
+}
+
+//read back a frame's results (if they are ready) into the per-scope windows:
+void collect(Frame &frame) {
+	if (!frame.pending) return;
+	frame.pending = false;
+	if (frame.records.empty()) return;
+
+	GLint available = 0;
+	glGetQueryObjectiv(frame.last_query, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) {
+		dropped += 1;
+		return;
+	}
+
+	std::vector< float > gpu_sum(scopes.size(), 0.0f);
+	std::vector< float > cpu_sum(scopes.size(), 0.0f);
+	std::vector< bool > ran(scopes.size(), false);
+	for (auto const &record : frame.records) {
+		if (record.end_query == 0) continue; //never closed
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(record.begin_query, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(record.end_query, GL_QUERY_RESULT, &end);
+		gpu_sum[record.scope] += float((end - begin) / 1.0e6);
+		cpu_sum[record.scope] += record.cpu_ms;
+		ran[record.scope] = true;
+	}
+	for (uint32_t i = 0; i < scopes.size(); ++i) {
+		if (!ran[i]) continue;
+		ScopeInfo &scope = scopes[i];
+		scope.gpu_ms[scope.next] = gpu_sum[i];
+		scope.cpu_ms[scope.next] = cpu_sum[i];
+		scope.next = (scope.next + 1) % Window;
+		scope.count = std::min(scope.count + 1, Window);
+	}
+}
+
+Summary summarize(std::array< float, Window > const &window, uint32_t count) {
+	Summary ret;
+	if (count == 0) return ret;
+	std::vector< float > ms(window.begin(), window.begin() + count);
+	std::sort(ms.begin(), ms.end());
+	float total = 0.0f;
+	for (float m : ms) total += m;
+	ret.mean = total / count;
+	ret.median = ms[count / 2];
+	ret.p95 = ms[std::min(count - 1, count * 95 / 100)];
+	ret.max = ms.back();
+	return ret;
+}
+
+} //end anon namespace
+
+//------------------
+
+void begin_frame() {
+	if (!enabled) return;
+	if (in_frame) end_frame();
+
+	Frame &frame = frames[frame_index % FrameLag];
+	collect(frame);
+	frame.used = 0;
+	frame.records.clear();
+	frame.last_query = 0;
+	frame.pending = true;
+
+	stack.clear();
+	in_frame = true;
+	push("frame");
+}
+
+void end_frame() {
+	if (!in_frame) return;
+	while (!stack.empty()) pop();
+	in_frame = false;
+	frame_index += 1;
+}
+
+void push(char const *name) {
+	if (!in_frame) return;
+	Frame &frame = frames[frame_index % FrameLag];
+
+	Record record;
+	record.scope = find_scope(name, uint32_t(stack.size()));
+	record.begin_query = next_query(frame);
+	record.end_query = 0;
+	record.cpu_ms = 0.0f;
+	glQueryCounter(record.begin_query, GL_TIMESTAMP);
+
+	stack.emplace_back();
+	stack.back().record = uint32_t(frame.records.size());
+	stack.back().start = std::chrono::high_resolution_clock::now();
+	frame.records.emplace_back(record);
+}
+
+void pop() {
+	if (!in_frame || stack.empty()) return;
+	Frame &frame = frames[frame_index % FrameLag];
+
+	Record &record = frame.records[stack.back().record];
+	record.end_query = next_query(frame);
+	glQueryCounter(record.end_query, GL_TIMESTAMP);
+	record.cpu_ms = std::chrono::duration< float, std::milli >(std::chrono::high_resolution_clock::now() - stack.back().start).count();
+	frame.last_query = record.end_query;
+
+	stack.pop_back();
+}
+
+std::vector< Stats > report() {
+	std::vector< Stats > ret;
+	ret.reserve(scopes.size());
+	for (auto const &scope : scopes) {
+		ret.emplace_back();
+		Stats &stats = ret.back();
+		stats.name = scope.name;
+		stats.depth = scope.depth;
+		stats.samples = scope.count;
+		stats.gpu = summarize(scope.gpu_ms, scope.count);
+		stats.cpu = summarize(scope.cpu_ms, scope.count);
+	}
+	return ret;
+}
+
+bool latest(char const *name, float *gpu_ms, float *cpu_ms) {
+	for (auto const &scope : scopes) {
+		if (scope.name != name && std::strcmp(scope.name, name) != 0) continue;
+		if (scope.count == 0) return false;
+		uint32_t last = (scope.next + Window - 1) % Window;
+		if (gpu_ms) *gpu_ms = scope.gpu_ms[last];
+		if (cpu_ms) *cpu_ms = scope.cpu_ms[last];
+		return true;
+	}
+	return false;
+}
+
+uint32_t dropped_frames() {
+	return dropped;
+}
+
+void shutdown() {
+	if (readout_stream) {
+		GLState::bind_vertex_array(0);
+		glDeleteVertexArrays(1, &readout_vao);
+		readout_vao = 0;
+		delete readout_stream;
+		readout_stream = nullptr;
+	}
+	for (auto &frame : frames) {
+		if (!frame.queries.empty()) glDeleteQueries(GLsizei(frame.queries.size()), frame.queries.data());
+		frame = Frame();
+	}
+	stack.clear();
+	in_frame = false;
+}
+
+//------------------
+
+//bar_program draws flat-colored triangles given in clip space:
+Load< GLuint > bar_program(LoadTagShaders, [](){
+	GLuint *ret = new GLuint(submit_program(
+		"#version 330\n"
+		"in vec4 Position;\n"
+		"in vec4 Color;\n"
+		"out vec4 color;\n"
+		"void main() {\n"
+		"	gl_Position = Position;\n"
+		"	color = Color;\n"
+		"}\n"
+	,
+		"#version 330\n"
+		"in vec4 color;\n"
+		"out vec4 fragColor;\n"
+		"void main() {\n"
+		"	fragColor = color;\n"
+		"}\n"
+	));
+
+	add_load_function(LoadTagLink, [ret](){
+		finish_program(*ret);
+	});
+
+	return ret;
+});
+
+void draw_readout(glm::uvec2 const &drawable_size) {
+	if (!enabled) return;
+	std::vector< Stats > stats = report();
+	if (stats.empty()) return;
+
+	struct Vertex {
+		glm::vec2 Position;
+		glm::u8vec4 Color;
+	};
+	static_assert(sizeof(Vertex) == 2*4+4*1, "Vertex is packed.");
+	if (!readout_stream) {
+		readout_stream = new StreamBuffer(64 * 1024);
+		readout_stream->Position = MeshBuffer::Attrib(2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
+		readout_stream->Color = MeshBuffer::Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
+		readout_vao = readout_stream->make_vao_for_program(*bar_program);
+	}
+
+	GLState::disable(GL_DEPTH_TEST);
+	GLState::enable(GL_BLEND);
+	GLState::blend_equation(GL_FUNC_ADD);
+	GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	//layout is in the same [-aspect,aspect]x[-1,1] space as draw_text:
+	float aspect = drawable_size.x / float(drawable_size.y);
+	float const row = 0.06f;
+	float const text_height = 0.04f;
+	float const left = -aspect + 0.02f;
+	float const bars_left = left + 0.6f;
+	float const budget_ms = 1000.0f / 60.0f;
+	float const budget_width = 0.3f; //width of one 60Hz frame
+	float const top = 1.0f - 0.02f;
+	float const bottom = top - row * stats.size();
+
+	std::vector< Vertex > verts;
+	auto rect = [&](glm::vec2 const &min, glm::vec2 const &max, glm::vec4 const &color) {
+		glm::u8vec4 c = glm::u8vec4(glm::clamp(color, glm::vec4(0.0f), glm::vec4(1.0f)) * 255.0f);
+		glm::vec2 a = glm::vec2(min.x / aspect, min.y);
+		glm::vec2 b = glm::vec2(max.x / aspect, max.y);
+		verts.emplace_back(Vertex{glm::vec2(a.x, a.y), c});
+		verts.emplace_back(Vertex{glm::vec2(b.x, a.y), c});
+		verts.emplace_back(Vertex{glm::vec2(b.x, b.y), c});
+		verts.emplace_back(Vertex{glm::vec2(a.x, a.y), c});
+		verts.emplace_back(Vertex{glm::vec2(b.x, b.y), c});
+		verts.emplace_back(Vertex{glm::vec2(a.x, b.y), c});
+	};
+	auto bar = [&](float y0, float y1, Summary const &summary, glm::vec4 const &color) {
+		float mean = std::min(summary.mean / budget_ms, 3.0f) * budget_width;
+		float p95 = std::min(summary.p95 / budget_ms, 3.0f) * budget_width;
+		rect(glm::vec2(bars_left, y0), glm::vec2(bars_left + mean, y1), color);
+		rect(glm::vec2(bars_left + p95 - 0.004f, y0), glm::vec2(bars_left + p95, y1), glm::vec4(glm::vec3(color), 1.0f));
+	};
+
+	//backdrop:
+	rect(glm::vec2(left - 0.01f, bottom - 0.01f), glm::vec2(bars_left + 3.0f * budget_width + 0.01f, top + 0.01f), glm::vec4(0.0f, 0.0f, 0.0f, 0.6f));
+
+	float y = top;
+	for (auto const &s : stats) {
+		y -= row;
+		bar(y + 0.5f * row, y + 0.9f * row, s.gpu, glm::vec4(1.0f, 0.6f, 0.2f, 0.8f));
+		bar(y + 0.1f * row, y + 0.5f * row, s.cpu, glm::vec4(0.3f, 0.6f, 1.0f, 0.8f));
+	}
+
+	//lines at one, two, and three 60Hz frames:
+	for (uint32_t i = 1; i <= 3; ++i) {
+		float x = bars_left + i * budget_width;
+		rect(glm::vec2(x - 0.002f, bottom), glm::vec2(x, top), glm::vec4(1.0f, 1.0f, 1.0f, 0.5f));
+	}
+
+	StreamBuffer::Allocation allocation = readout_stream->allocate(verts.size() * sizeof(Vertex), sizeof(Vertex));
+	std::memcpy(allocation.data, verts.data(), verts.size() * sizeof(Vertex));
+	readout_stream->upload();
+
+	GLState::use_program(*bar_program);
+	GLState::bind_vertex_array(readout_vao);
+	glDrawArrays(GL_TRIANGLES, GLint(allocation.offset / sizeof(Vertex)), GLsizei(verts.size()));
+
+	//labels (the menu font only has capital letters and '*', so the label keeps just those):
+	y = top;
+	for (auto const &s : stats) {
+		y -= row;
+		std::string label = s.name;
+		for (auto &c : label) {
+			if (c >= 'a' && c <= 'z') c = c - 'a' + 'A';
+			else if (!(c >= 'A' && c <= 'Z') && c != '*') c = ' ';
+		}
+		draw_text(label, glm::vec2(left + 0.03f * s.depth, y + 0.01f), text_height, glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
+	}
+}
+
+} //namespace GPUProfiler
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+//GPUProfiler measures named parts of each frame on both the GPU (GL_TIMESTAMP queries)
+// and the CPU, so it is possible to tell which one is holding up a frame.
+//Query results are read back a few frames late -- and dropped rather than waited on if
+// they still aren't ready -- so profiling never stalls the pipeline.
+//
+//Usage:
+// GPUProfiler::begin_frame(); //once per frame, before drawing
+// { GPUProfiler::Scope scope("Scene::draw"); scene.draw(camera); }
+// GPUProfiler::end_frame(); //once per frame, after drawing
+//
+//Scope names must be string literals (they are compared by pointer first, and kept).
+//A scope that runs several times in one frame is reported as the sum of those runs.
+
+namespace GPUProfiler {
+
+//when false, scopes do nothing (no queries are issued):
+extern bool enabled;
+
+void begin_frame();
+void end_frame();
+
+void push(char const *name);
+void pop();
+
+struct Scope {
+	Scope(char const *name) { push(name); }
+	~Scope() { pop(); }
+	Scope(Scope const &) = delete;
+	Scope &operator=(Scope const &) = delete;
+};
+
+//rolling statistics (over the last ~120 frames in which a scope ran), in milliseconds:
+struct Summary {
+	float mean = 0.0f;
+	float median = 0.0f;
+	float p95 = 0.0f;
+	float max = 0.0f;
+};
+struct Stats {
+	std::string name;
+	uint32_t depth = 0; //nesting depth (the whole frame is at depth 0)
+	uint32_t samples = 0;
+	Summary gpu;
+	Summary cpu;
+};
+//one entry per scope (including the whole-frame scope, named "frame"), in the order scopes were first seen:
+std::vector< Stats > report();
+//most recent results for a scope (returns false if there are none yet):
+bool latest(char const *name, float *gpu_ms, float *cpu_ms);
+//number of frames whose results were dropped because they weren't ready in time:
+uint32_t dropped_frames();
+
+//free the profiler's queries and readout buffers (call before the GL context goes away; statistics are kept):
+void shutdown();
+
+//draw report() as bars over the current framebuffer (GPU above CPU for each scope; vertical lines mark 60Hz budgets):
+void draw_readout(glm::uvec2 const &drawable_size);
+
+} //namespace GPUProfiler
@@ -9,7 +9,9 @@
 #include "data_path.hpp" //helper to get paths relative to executable
 #include "compile_program.hpp" //helper to compile opengl shader programs
 #include "draw_text.hpp" //helper to... um.. draw text
-#include "vertex_color_program.hpp"
+#include "ShaderVariants.hpp"
+#include "Materials.hpp"
+#include "GLState.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
@@ -26,7 +28,7 @@ MeshBuffer::Mesh doll_mesh;
 MeshBuffer::Mesh egg_mesh;
 MeshBuffer::Mesh cube_mesh;
 
-Load< MeshBuffer > meshes(LoadTagDefault, [](){
+Load< MeshBuffer > meshes(LoadTagInit, [](){
 	MeshBuffer const *ret = new MeshBuffer(data_path("meshes.pnc"));
 
 	tile_mesh = ret->lookup("Tile");
@@ -38,8 +40,12 @@ Load< MeshBuffer > meshes(LoadTagDefault, [](){
 	return ret;
 });
 
-Load< GLuint > meshes_for_vertex_color_program(LoadTagDefault, [](){
-	return new GLuint(meshes->make_vao_for_program(vertex_color_program->program));
+Load< ShaderVariants::Program > game_program(LoadTagShaders, [](){
+	return ShaderVariants::load(0); //(no extra features)
+});
+
+Load< GLuint > meshes_for_game_program(LoadTagDefault, [](){
+	return new GLuint(meshes->make_vao_for_program(game_program->program));
 });
 
 
@@ -146,10 +152,10 @@ void GameMode::update(float elapsed) {
 
 void GameMode::draw(glm::uvec2 const &drawable_size) {
 	//set up basic OpenGL state:
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_BLEND);
-	glBlendEquation(GL_FUNC_ADD);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::enable(GL_DEPTH_TEST);
+	GLState::enable(GL_BLEND);
+	GLState::blend_equation(GL_FUNC_ADD);
+	GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	//Set up a transformation matrix to fit the board in the window:
 	glm::mat4 world_to_clip;
@@ -175,28 +181,30 @@ void GameMode::draw(glm::uvec2 const &drawable_size) {
 	}
 
 	//set up graphics pipeline to use data from the meshes and the simple shading program:
-	glBindVertexArray(*meshes_for_vertex_color_program);
-	glUseProgram(vertex_color_program->program);
+	GLState::bind_vertex_array(*meshes_for_game_program);
+	GLState::use_program(game_program->program);
 
-	glUniform3fv(vertex_color_program->sun_color_vec3, 1, glm::value_ptr(glm::vec3(0.81f, 0.81f, 0.76f)));
-	glUniform3fv(vertex_color_program->sun_direction_vec3, 1, glm::value_ptr(glm::normalize(glm::vec3(-0.2f, 0.2f, 1.0f))));
-	glUniform3fv(vertex_color_program->sky_color_vec3, 1, glm::value_ptr(glm::vec3(0.2f, 0.2f, 0.3f)));
-	glUniform3fv(vertex_color_program->sky_direction_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 1.0f, 0.0f)));
+	GLState::uniform(game_program->sun_color_vec3, glm::vec3(0.81f, 0.81f, 0.76f));
+	GLState::uniform(game_program->sun_direction_vec3, glm::normalize(glm::vec3(-0.2f, 0.2f, 1.0f)));
+	GLState::uniform(game_program->sky_color_vec3, glm::vec3(0.2f, 0.2f, 0.3f));
+	GLState::uniform(game_program->sky_direction_vec3, glm::vec3(0.0f, 1.0f, 0.0f));
+	//(the board is drawn in plain vertex colors):
+	Materials::bind(Materials::Default);
 
 	//helper function to draw a given mesh with a given transformation:
 	auto draw_mesh = [&](MeshBuffer::Mesh const &mesh, glm::mat4 const &object_to_world) {
 		//set up the matrix uniforms:
-		if (vertex_color_program->object_to_clip_mat4 != -1U) {
+		if (game_program->object_to_clip_mat4 != -1U) {
 			glm::mat4 object_to_clip = world_to_clip * object_to_world;
-			glUniformMatrix4fv(vertex_color_program->object_to_clip_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
+			GLState::uniform(game_program->object_to_clip_mat4, object_to_clip);
 		}
-		if (vertex_color_program->object_to_light_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(vertex_color_program->object_to_light_mat4x3, 1, GL_FALSE, glm::value_ptr(object_to_world));
+		if (game_program->object_to_light_mat4x3 != -1U) {
+			GLState::uniform(game_program->object_to_light_mat4x3, glm::mat4x3(object_to_world));
 		}
-		if (vertex_color_program->normal_to_light_mat3 != -1U) {
+		if (game_program->normal_to_light_mat3 != -1U) {
 			//NOTE: if there isn't any non-uniform scaling in the object_to_world matrix, then the inverse transpose is the matrix itself, and computing it wastes some CPU time:
 			glm::mat3 normal_to_world = glm::inverse(glm::transpose(glm::mat3(object_to_world)));
-			glUniformMatrix3fv(vertex_color_program->normal_to_light_mat3, 1, GL_FALSE, glm::value_ptr(normal_to_world));
+			GLState::uniform(game_program->normal_to_light_mat3, normal_to_world);
 		}
 
 		//draw the mesh:
@@ -234,14 +242,12 @@ void GameMode::draw(glm::uvec2 const &drawable_size) {
 	);
 
 	if (Mode::current.get() == this) {
-		glDisable(GL_DEPTH_TEST);
+		GLState::disable(GL_DEPTH_TEST);
 		std::string message = "PRESS ESC FOR MENU";
 		float height = 0.06f;
 		float width = text_width(message, height);
 		draw_text(message, glm::vec2(-0.5f * width,-0.99f), height, glm::vec4(0.0f, 0.0f, 0.0f, 0.5f));
 		draw_text(message, glm::vec2(-0.5f * width,-1.0f), height, glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
-
-		glUseProgram(0);
 	}
 
 	GL_ERRORS();
@@ -253,6 +259,7 @@ void GameMode::show_pause_menu() {
 
 	std::shared_ptr< Mode > game = shared_from_this();
 	menu->background = game;
+	menu->background_time_scale = 0.0f; //(paused; this also keeps the cached background accurate)
 
 	menu->choices.emplace_back("PAUSED");
 	menu->choices.emplace_back("RESUME", [game](){
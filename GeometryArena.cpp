@@ -0,0 +1,259 @@
+#include "GeometryArena.hpp"
+
+#include "GLState.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <cassert>
+
+namespace {
+	std::map< std::string, GeometryArena * > &get_arenas() {
+		static std::map< std::string, GeometryArena * > arenas;
+		return arenas;
+	}
+}
+
+GeometryArena &GeometryArena::for_layout(Layout const &layout_) {
+	//only attributes that are present are part of the layout:
+	Layout layout;
+	for (auto const &attrib : layout_) {
+		if (attrib.second.size != 0) layout.emplace_back(attrib);
+	}
+	if (layout.empty()) {
+		throw std::runtime_error("GeometryArena needs at least one attribute in its layout.");
+	}
+
+	//layouts are identified by a description of every attribute:
+	std::string key;
+	for (auto const &attrib : layout) {
+		MeshBuffer::Attrib const &a = attrib.second;
+		key += std::string(attrib.first) + ":" + std::to_string(a.size) + "," + std::to_string(a.type)
+			+ "," + std::to_string(int(a.normalized)) + "," + std::to_string(a.stride) + "," + std::to_string(a.offset) + ";";
+	}
+
+	auto &arenas = get_arenas();
+	auto f = arenas.find(key);
+	if (f == arenas.end()) {
+		f = arenas.insert(std::make_pair(key, new GeometryArena(layout))).first;
+	}
+	return *f->second;
+}
+
+std::map< std::string, GeometryArena * > const &GeometryArena::all() {
+	return get_arenas();
+}
+
+GeometryArena::GeometryArena(Layout const &layout_) : layout(layout_) {
+	stride = layout[0].second.stride;
+	for (auto const &attrib : layout) {
+		if (attrib.second.stride != stride) {
+			throw std::runtime_error("GeometryArena layout has attributes with different strides.");
+		}
+	}
+}
+
+uint32_t GeometryArena::allocate(void const *data, GLuint count) {
+	//find the first hole that fits:
+	auto hole = holes.end();
+	if (count > 0) {
+		for (auto h = holes.begin(); h != holes.end(); ++h) {
+			if (h->second >= count) {
+				hole = h;
+				break;
+			}
+		}
+		if (hole == holes.end()) {
+			//grow (at least doubling, to keep the number of copies down), adding the new space as a hole:
+			GLuint old_capacity = capacity;
+			GLuint new_capacity = std::max(capacity * 2, capacity + count);
+			std::vector< std::pair< uint32_t, GLuint > > moves;
+			for (uint32_t id = 0; id < allocations.size(); ++id) {
+				if (allocations[id].live) moves.emplace_back(id, allocations[id].first);
+			}
+			rebuffer(new_capacity, moves);
+
+			GLuint first = old_capacity;
+			GLuint size = new_capacity - old_capacity;
+			//merge with a hole at the old end of the buffer:
+			if (!holes.empty()) {
+				auto last = std::prev(holes.end());
+				if (last->first + last->second == old_capacity) {
+					first = last->first;
+					size += last->second;
+					holes.erase(last);
+				}
+			}
+			hole = holes.insert(std::make_pair(first, size)).first;
+		}
+	}
+
+	uint32_t id;
+	if (!free_ids.empty()) {
+		id = free_ids.back();
+		free_ids.pop_back();
+	} else {
+		id = uint32_t(allocations.size());
+		allocations.emplace_back();
+	}
+	Allocation &allocation = allocations[id];
+	allocation.count = count;
+	allocation.live = true;
+	allocation.first = 0;
+
+	if (count > 0) {
+		allocation.first = hole->first;
+		GLuint remaining = hole->second - count;
+		holes.erase(hole);
+		if (remaining > 0) {
+			holes.insert(std::make_pair(allocation.first + count, remaining));
+		}
+
+		GLState::bind_buffer(GL_ARRAY_BUFFER, vbo);
+		glBufferSubData(GL_ARRAY_BUFFER, GLintptr(allocation.first) * stride, GLsizeiptr(count) * stride, data);
+		used += count;
+	}
+
+	return id;
+}
+
+void GeometryArena::free(uint32_t id) {
+	assert(id < allocations.size() && allocations[id].live && "Freeing an allocation that isn't live.");
+	Allocation &allocation = allocations[id];
+	allocation.live = false;
+	free_ids.emplace_back(id);
+	if (allocation.count == 0) return;
+	used -= allocation.count;
+
+	//add a hole, merged with the holes on either side:
+	GLuint first = allocation.first;
+	GLuint count = allocation.count;
+	auto after = holes.lower_bound(first);
+	if (after != holes.end() && first + count == after->first) {
+		count += after->second;
+		after = holes.erase(after);
+	}
+	if (after != holes.begin()) {
+		auto before = std::prev(after);
+		if (before->first + before->second == first) {
+			first = before->first;
+			count += before->second;
+			holes.erase(before);
+		}
+	}
+	holes.insert(std::make_pair(first, count));
+}
+
+GLuint GeometryArena::first(uint32_t id) const {
+	assert(id < allocations.size() && allocations[id].live && "Looking up an allocation that isn't live.");
+	return allocations[id].first;
+}
+
+void GeometryArena::compact() {
+	if (capacity == used) return; //no holes
+
+	//pack live allocations, in their current order, from the start of a buffer that just fits them:
+	std::vector< std::pair< uint32_t, GLuint > > order;
+	for (uint32_t id = 0; id < allocations.size(); ++id) {
+		if (allocations[id].live && allocations[id].count > 0) order.emplace_back(id, allocations[id].first);
+	}
+	std::sort(order.begin(), order.end(), [](std::pair< uint32_t, GLuint > const &a, std::pair< uint32_t, GLuint > const &b) {
+		return a.second < b.second;
+	});
+	GLuint next = 0;
+	for (auto &move : order) {
+		move.second = next;
+		next += allocations[move.first].count;
+	}
+	assert(next == used);
+
+	rebuffer(used, order);
+	holes.clear();
+	compactions += 1;
+}
+
+void GeometryArena::compact_all() {
+	for (auto const &arena : get_arenas()) {
+		arena.second->compact();
+	}
+}
+
+void GeometryArena::rebuffer(GLuint new_capacity, std::vector< std::pair< uint32_t, GLuint > > const &moves) {
+	GLuint new_vbo = 0;
+	glGenBuffers(1, &new_vbo);
+	GLState::bind_buffer(GL_COPY_WRITE_BUFFER, new_vbo);
+	glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(new_capacity) * stride, nullptr, GL_STATIC_DRAW);
+
+	if (vbo != 0) {
+		//copy allocations over on the GPU:
+		GLState::bind_buffer(GL_COPY_READ_BUFFER, vbo);
+		for (auto const &move : moves) {
+			Allocation &allocation = allocations[move.first];
+			if (allocation.count > 0) {
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+					GLintptr(allocation.first) * stride, GLintptr(move.second) * stride, GLsizeiptr(allocation.count) * stride);
+			}
+			allocation.first = move.second;
+		}
+		GLState::forget_buffer(vbo);
+		glDeleteBuffers(1, &vbo);
+	}
+	vbo = new_vbo;
+	capacity = new_capacity;
+
+	//vaos captured the old buffer, so point them at the new one:
+	for (auto const &vao : vaos) {
+		bind_vao(vao.second, vao.first);
+	}
+}
+
+void GeometryArena::bind_vao(GLuint vao, std::vector< GLint > const &locations) {
+	assert(locations.size() == layout.size());
+	GLState::bind_vertex_array(vao);
+	GLState::bind_buffer(GL_ARRAY_BUFFER, vbo);
+	for (uint32_t i = 0; i < layout.size(); ++i) {
+		if (locations[i] == -1) continue;
+		MeshBuffer::Attrib const &attrib = layout[i].second;
+		glVertexAttribPointer(locations[i], attrib.size, attrib.type, attrib.normalized, attrib.stride, (GLbyte *)0 + attrib.offset);
+		glEnableVertexAttribArray(locations[i]);
+	}
+}
+
+GLuint GeometryArena::vao_for_program(GLuint program) {
+	//find where the program wants each attribute:
+	std::vector< GLint > locations;
+	locations.reserve(layout.size());
+	for (auto const &attrib : layout) {
+		GLint location = glGetAttribLocation(program, attrib.first);
+		if (location == -1) {
+			std::cerr << "WARNING: attribute '" << attrib.first << "' in mesh buffer isn't active in program." << std::endl;
+		}
+		locations.emplace_back(location);
+	}
+
+	//Check that all active attributes are bound:
+	GLint active = 0;
+	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &active);
+	assert(active >= 0 && "Doesn't makes sense to have negative active attributes.");
+	for (GLuint i = 0; i < GLuint(active); ++i) {
+		GLchar name[100];
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveAttrib(program, i, 100, NULL, &size, &type, name);
+		name[99] = '\0';
+		GLint location = glGetAttribLocation(program, name);
+		if (std::find(locations.begin(), locations.end(), location) == locations.end()) {
+			throw std::runtime_error("ERROR: active attribute '" + std::string(name) + "' in program is not bound.");
+		}
+	}
+
+	//programs with the same locations share a vao:
+	auto f = vaos.find(locations);
+	if (f == vaos.end()) {
+		GLuint vao = 0;
+		glGenVertexArrays(1, &vao);
+		bind_vao(vao, locations);
+		f = vaos.insert(std::make_pair(locations, vao)).first;
+	}
+	return f->second;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "GL.hpp"
+#include "MeshBuffer.hpp"
+
+#include <map>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+//"GeometryArena" holds the vertices of every MeshBuffer with a given vertex layout in one shared vbo.
+// MeshBuffers sub-allocate ranges from it (so their meshes' start indices are offset into the shared
+// buffer), and vertex array objects are shared too: one vao per layout (per set of attribute
+// locations, really) serves every mesh of that layout, so drawing meshes from different files doesn't
+// switch vaos.
+//
+//The buffer grows (copying on the GPU) as needed; vaos made by vao_for_program() are updated to
+// point at the new buffer, so their names stay valid.
+//
+//Freed ranges are reused by later allocations. compact() moves allocations together to remove
+// holes; since that changes where meshes start, mesh ranges looked up earlier (e.g. stored in
+// Scene::Objects) are stale afterward -- so compact between modes/levels, not in the middle of one.
+
+struct GeometryArena {
+	//vertex layout, as (attribute name, Attrib) pairs; all Attribs share the same stride:
+	typedef std::vector< std::pair< char const *, MeshBuffer::Attrib > > Layout;
+
+	//the arena for a given layout (created on first use):
+	static GeometryArena &for_layout(Layout const &layout);
+	//all arenas:
+	static std::map< std::string, GeometryArena * > const &all();
+
+	//copy 'count' vertices into the arena (stride bytes each); returns an allocation id:
+	uint32_t allocate(void const *data, GLuint count);
+	//release an allocation:
+	void free(uint32_t allocation);
+	//index of the first vertex of an allocation in vbo:
+	GLuint first(uint32_t allocation) const;
+
+	//move allocations together to close holes left by free() (and shrink the buffer to fit):
+	void compact();
+	static void compact_all();
+
+	//get a vertex array object that binds this arena's vbo to a program's attributes:
+	// (shared between programs with the same attribute locations, so don't delete it)
+	//  will throw if program defines attributes not contained in the layout
+	//  and warn if the layout contains attributes not active in the program
+	GLuint vao_for_program(GLuint program);
+
+	//statistics (in vertices):
+	GLuint capacity = 0; //size of vbo
+	GLuint used = 0; //in live allocations
+	uint32_t compactions = 0; //number of times compact() moved anything
+
+	//internals:
+	Layout layout;
+	GLsizei stride = 0;
+	GLuint vbo = 0;
+
+	struct Allocation {
+		GLuint first = 0;
+		GLuint count = 0;
+		bool live = false;
+	};
+	std::vector< Allocation > allocations; //indexed by allocation id
+	std::vector< uint32_t > free_ids; //dead entries in 'allocations', for reuse
+	std::map< GLuint, GLuint > holes; //free ranges in [0, capacity): first -> count (never adjacent)
+
+	std::map< std::vector< GLint >, GLuint > vaos; //attribute locations (in layout order) -> vao
+
+	//replace vbo with a buffer of 'new_capacity' vertices, copying allocations to the offsets in 'moves' (id -> new first):
+	void rebuffer(GLuint new_capacity, std::vector< std::pair< uint32_t, GLuint > > const &moves);
+	//point a vao's attributes at vbo:
+	void bind_vao(GLuint vao, std::vector< GLint > const &locations);
+
+	GeometryArena(Layout const &layout);
+	GeometryArena(GeometryArena const &) = delete;
+	GeometryArena &operator=(GeometryArena const &) = delete;
+};
@@ -0,0 +1,279 @@
+#include "Jobs.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+namespace Jobs {
+
+struct Job {
+	std::function< void() > function;
+	Group *group = nullptr;
+	std::atomic< uint32_t > waiting{1}; //groups still to finish (plus one, until run() is done with the job)
+};
+
+namespace {
+//local data:
+
+struct Deque {
+	std::mutex mutex;
+	std::deque< Job * > jobs;
+};
+
+struct State {
+	//deques[i] belongs to worker i; deques[0] is only used while there are no workers (jobs run before init(), or after shutdown()):
+	std::vector< std::unique_ptr< Deque > > deques;
+	std::vector< std::thread > workers;
+	std::thread::id main_thread;
+
+	//jobs sitting in deques (may briefly dip below zero, as jobs are popped before being counted):
+	std::atomic< int32_t > queued{0};
+	//jobs queued by threads without a deque of their own (the main thread, once there are workers)
+	// go to worker deques in turn, so the main thread is never left holding background work:
+	std::atomic< uint32_t > next_deque{0};
+	//idle workers sleep on 'wake':
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	bool quit = false;
+
+	std::mutex main_mutex;
+	std::vector< std::function< void() > > main_queue;
+
+	Group frame;
+
+	State() {
+		deques.emplace_back(new Deque);
+		main_thread = std::this_thread::get_id();
+	}
+	~State() {
+		shutdown();
+	}
+};
+
+State &get_state() {
+	static State state;
+	return state;
+}
+
+thread_local uint32_t this_deque = 0;
+
+void push(Job *job) {
+	State &state = get_state();
+	uint32_t count = uint32_t(state.deques.size());
+	uint32_t index = std::min(this_deque, count - 1);
+	if (index == 0 && count > 1) {
+		index = 1 + state.next_deque.fetch_add(1) % (count - 1);
+	}
+	Deque &deque = *state.deques[index];
+	{
+		std::lock_guard< std::mutex > lock(deque.mutex);
+		deque.jobs.push_back(job);
+	}
+	state.queued += 1;
+	{ //(so a worker can't miss the wake-up between checking 'queued' and sleeping)
+		std::lock_guard< std::mutex > lock(state.sleep_mutex);
+	}
+	state.wake.notify_one();
+}
+
+//a job's group (or a group it was waiting on) finished -- queue it if that was the last thing it waited for:
+void release(Job *job) {
+	if (job->waiting.fetch_sub(1) == 1) push(job);
+}
+
+void finish(Group *group) {
+	std::vector< Job * > ready;
+	{
+		std::lock_guard< std::mutex > lock(group->mutex);
+		if (group->pending.fetch_sub(1) == 1) {
+			ready.swap(group->continuations);
+		}
+	}
+	for (Job *job : ready) {
+		release(job);
+	}
+}
+
+//take a job from the back (owner) or front (thief) of a deque -- or, if 'only' is given, the
+// job nearest that end that belongs to group 'only' -- or return nullptr:
+Job *take(Deque &deque, bool back, Group *only) {
+	std::lock_guard< std::mutex > lock(deque.mutex);
+	if (deque.jobs.empty()) return nullptr;
+	if (!only) {
+		Job *job = (back ? deque.jobs.back() : deque.jobs.front());
+		if (back) deque.jobs.pop_back();
+		else deque.jobs.pop_front();
+		return job;
+	}
+	for (size_t i = 0; i < deque.jobs.size(); ++i) {
+		size_t at = (back ? deque.jobs.size() - 1 - i : i);
+		if (deque.jobs[at]->group == only) {
+			Job *job = deque.jobs[at];
+			deque.jobs.erase(deque.jobs.begin() + at);
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+//run one job from this thread's deque, or stolen from another's (only jobs in group 'only', if given);
+// returns false if there were none:
+bool run_one(Group *only = nullptr) {
+	State &state = get_state();
+	uint32_t count = uint32_t(state.deques.size());
+	uint32_t self = std::min(this_deque, count - 1);
+	Job *job = take(*state.deques[self], true, only);
+	for (uint32_t i = 1; i < count && !job; ++i) {
+		job = take(*state.deques[(self + i) % count], false, only);
+	}
+	if (!job) return false;
+	state.queued -= 1;
+
+	job->function();
+	Group *group = job->group;
+	delete job;
+	if (group) finish(group);
+	return true;
+}
+
+void worker(uint32_t index) {
+	State &state = get_state();
+	this_deque = index;
+	while (true) {
+		if (run_one()) continue;
+		std::unique_lock< std::mutex > lock(state.sleep_mutex);
+		state.wake.wait(lock, [&state](){ return state.quit || state.queued.load() > 0; });
+		if (state.quit && state.queued.load() <= 0) return;
+	}
+}
+
+} //end anon namespace
+
+//------------------
+
+void init(uint32_t workers) {
+	State &state = get_state();
+	assert(state.workers.empty() && "Jobs::init called twice.");
+	state.main_thread = std::this_thread::get_id();
+	this_deque = 0;
+	if (workers == 0) {
+		workers = std::max(2U, std::thread::hardware_concurrency()) - 1;
+	}
+	//(deques are created before any worker starts, so 'deques' never changes while workers run)
+	for (uint32_t i = 0; i < workers; ++i) {
+		state.deques.emplace_back(new Deque);
+	}
+	state.quit = false;
+	for (uint32_t i = 0; i < workers; ++i) {
+		state.workers.emplace_back(worker, i + 1);
+	}
+}
+
+void shutdown() {
+	State &state = get_state();
+	if (state.workers.empty()) return;
+	state.frame.wait();
+	{
+		std::lock_guard< std::mutex > lock(state.sleep_mutex);
+		state.quit = true;
+	}
+	state.wake.notify_all();
+	for (auto &thread : state.workers) {
+		thread.join();
+	}
+	state.workers.clear();
+	state.deques.resize(1);
+	//(anything left over runs here)
+	while (run_one()) { }
+	if (on_main_thread()) run_main_queue();
+}
+
+uint32_t threads() {
+	return uint32_t(get_state().deques.size());
+}
+
+bool on_main_thread() {
+	return std::this_thread::get_id() == get_state().main_thread;
+}
+
+void Group::wait() {
+	//a waiting thread only helps with this group's jobs, so e.g. a texture decode can't end up on the critical
+	// path of the frame (on the main thread) or of a job waiting inside it (such as the simulation job's
+	// parallel_for); idle workers pick up everything else. Main-thread work is left for end_frame().
+	// (without workers, the one thread must run everything itself)
+	Group *only = (get_state().deques.size() > 1 ? this : nullptr);
+	while (pending.load() != 0) {
+		if (!run_one(only)) std::this_thread::yield();
+	}
+	//(the thread that finished the last job may still hold the mutex; wait for it to let go of this group)
+	std::lock_guard< std::mutex > lock(mutex);
+}
+
+void run(std::function< void() > const &function, Group *group, std::initializer_list< Group * > after) {
+	Job *job = new Job;
+	job->function = function;
+	job->group = group;
+	job->waiting = uint32_t(after.size()) + 1;
+	if (group) group->pending += 1;
+	for (Group *g : after) {
+		assert(g && g != group && "Jobs can't wait for their own group.");
+		std::lock_guard< std::mutex > lock(g->mutex);
+		if (g->pending.load() == 0) {
+			job->waiting -= 1;
+		} else {
+			g->continuations.emplace_back(job);
+		}
+	}
+	release(job);
+}
+
+void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, std::function< void(uint32_t, uint32_t) > const &body) {
+	if (end <= begin) return;
+	grain = std::max(1U, grain);
+	if (end - begin <= grain || threads() == 1) {
+		body(begin, end);
+		return;
+	}
+	Group group;
+	for (uint32_t chunk = begin + grain; chunk < end; chunk += std::min(grain, end - chunk)) {
+		uint32_t chunk_end = chunk + std::min(grain, end - chunk);
+		run([&body, chunk, chunk_end](){ body(chunk, chunk_end); }, &group);
+	}
+	body(begin, begin + grain);
+	group.wait();
+}
+
+Group &frame() {
+	return get_state().frame;
+}
+
+void run_on_main(std::function< void() > const &work) {
+	State &state = get_state();
+	std::lock_guard< std::mutex > lock(state.main_mutex);
+	state.main_queue.emplace_back(work);
+}
+
+void run_main_queue() {
+	State &state = get_state();
+	assert(on_main_thread() && "Main-thread work must run on the main thread.");
+	std::vector< std::function< void() > > running; //(swapped out, since work may queue more work)
+	{
+		std::lock_guard< std::mutex > lock(state.main_mutex);
+		if (state.main_queue.empty()) return;
+		running.swap(state.main_queue);
+	}
+	for (auto const &work : running) {
+		work();
+	}
+}
+
+void end_frame() {
+	State &state = get_state();
+	state.frame.wait();
+	run_main_queue();
+}
+
+} //namespace Jobs
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+//"Jobs" runs small pieces of work on a pool of worker threads (and on any thread waiting for jobs):
+// - every thread has its own deque of jobs: it pushes and pops jobs at the back (newest first, while
+//   their data is still in cache), and threads that run out of work steal from the front of other
+//   threads' deques (oldest first -- usually the biggest pieces of work);
+// - jobs belong to Groups, which can be waited on; a job may also be started only once other groups are done;
+// - frame() is a group that main() waits on at the end of every frame, for work started by Mode::update
+//   or Mode::draw that must be done before the next frame;
+// - run_on_main() queues work that must happen on the main thread (i.e. anything that calls OpenGL);
+//   main() runs it at the end of every frame (end_frame()), and at no other time;
+// - jobs started by the main thread go to the workers' deques, and a thread waiting on a group only
+//   helps with that group's jobs -- so background work (e.g. texture decoding) never runs on the main
+//   thread in the middle of a frame, or inside a job that is waiting for its own pieces.
+//
+//Usage:
+// Jobs::parallel_for(0, count, 256, [&](uint32_t begin, uint32_t end){
+//     for (uint32_t i = begin; i < end; ++i) { ... }
+// }); //(returns when every item is done)
+//
+// Jobs::Group loads;
+// Jobs::run([](){ decode(); }, &loads);
+// Jobs::run([](){ build(); }, &Jobs::frame(), {&loads}); //(runs once everything in 'loads' is done)
+//
+//NOTE: jobs must not wait on work queued with run_on_main() (only the main thread runs it).
+//NOTE: a waiting thread won't run other groups' jobs, so a group waited on inside a job should only
+// start 'after' groups that idle workers are free to finish.
+
+namespace Jobs {
+
+struct Job;
+
+//start worker threads (by default, one for each core but the main thread's, and at least one);
+// main() calls this before anything uses jobs:
+void init(uint32_t workers = 0);
+//run every queued job and stop the worker threads:
+void shutdown();
+
+//threads that run jobs (workers, plus the main thread):
+uint32_t threads();
+bool on_main_thread();
+
+struct Group {
+	Group() = default;
+	Group(Group const &) = delete;
+	Group &operator=(Group const &) = delete;
+	~Group() { wait(); }
+
+	//help run this group's jobs until every one of them is done:
+	void wait();
+	bool done() const { return pending.load() == 0; }
+
+	//internals:
+	std::atomic< uint32_t > pending{0}; //jobs in this group that haven't finished
+	std::mutex mutex; //guards 'continuations' (and is held while the last job finishes)
+	std::vector< Job * > continuations; //jobs waiting for this group to be done
+};
+
+//run 'job' on some thread, as part of 'group' (if given), once every group in 'after' is done:
+void run(std::function< void() > const &job, Group *group = nullptr, std::initializer_list< Group * > after = {});
+
+//call body(chunk_begin, chunk_end) for chunks of about 'grain' items covering [begin, end), spread
+// over all threads (the calling thread included); returns once every chunk is done.
+//(chunks start at begin + a multiple of 'grain')
+void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, std::function< void(uint32_t, uint32_t) > const &body);
+
+//the group for this frame's jobs:
+Group &frame();
+
+//queue work to run on the main thread:
+void run_on_main(std::function< void() > const &work);
+//run main-thread work queued so far (main thread only):
+void run_main_queue();
+
+//called by main() once per frame, after drawing: waits for frame() and runs main-thread work:
+void end_frame();
+
+} //namespace Jobs
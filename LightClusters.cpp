@@ -0,0 +1,239 @@
+#include "LightClusters.hpp"
+
+#include "GLState.hpp"
+#include "GPUProfiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define LIGHTCLUSTERS_SSE 1
+#endif
+
+static_assert(LightClusters::GridX % 4 == 0, "Clusters are tested four at a time along x.");
+
+LightClusters::LightClusters() {
+	min_x.resize(ClusterCount); min_y.resize(ClusterCount); min_z.resize(ClusterCount);
+	max_x.resize(ClusterCount); max_y.resize(ClusterCount); max_z.resize(ClusterCount);
+
+	auto make = [](GLuint *buffer, GLuint *tex, GLenum format) {
+		glGenBuffers(1, buffer);
+		GLState::bind_buffer(GL_TEXTURE_BUFFER, *buffer);
+		glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+		glGenTextures(1, tex);
+		glBindTexture(GL_TEXTURE_BUFFER, *tex);
+		glTexBuffer(GL_TEXTURE_BUFFER, format, *buffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	};
+	make(&lights_buffer, &lights_tex, GL_RGBA32F);
+	make(&clusters_buffer, &clusters_tex, GL_RG32UI);
+	make(&light_indices_buffer, &light_indices_tex, GL_R32UI);
+}
+
+LightClusters::~LightClusters() {
+	GLuint textures[3] = {lights_tex, clusters_tex, light_indices_tex};
+	glDeleteTextures(3, textures);
+	GLuint buffers[3] = {lights_buffer, clusters_buffer, light_indices_buffer};
+	for (GLuint buffer : buffers) {
+		GLState::forget_buffer(buffer);
+	}
+	glDeleteBuffers(3, buffers);
+}
+
+uint32_t LightClusters::slice(float depth) const {
+	if (depth < first_slice_depth) return 0;
+	//(same computation as in the Clustered shader variant)
+	float scale = float(GridZ - 1) / std::log(far_depth / first_slice_depth);
+	float bias = -std::log(first_slice_depth) * scale;
+	int32_t s = 1 + int32_t(std::log(depth) * scale + bias);
+	return uint32_t(std::max(0, std::min(int32_t(GridZ) - 1, s)));
+}
+
+void LightClusters::compute_bounds(Scene::Camera const *camera) {
+	bounds_fovy = camera->fovy;
+	bounds_aspect = camera->aspect;
+	bounds_near = camera->near;
+	bounds_first_slice_depth = first_slice_depth;
+	bounds_far_depth = far_depth;
+
+	//view-space extent of one unit of NDC per unit of depth:
+	float sy = std::tan(0.5f * camera->fovy);
+	float sx = sy * camera->aspect;
+
+	for (uint32_t z = 0; z < GridZ; ++z) {
+		float near_depth, far_depth_z;
+		if (z == 0) {
+			near_depth = camera->near;
+			far_depth_z = first_slice_depth;
+		} else {
+			float ratio = far_depth / first_slice_depth;
+			near_depth = first_slice_depth * std::pow(ratio, float(z - 1) / float(GridZ - 1));
+			far_depth_z = first_slice_depth * std::pow(ratio, float(z) / float(GridZ - 1));
+		}
+		for (uint32_t y = 0; y < GridY; ++y) {
+			float y0 = (-1.0f + 2.0f * y / float(GridY)) * sy;
+			float y1 = (-1.0f + 2.0f * (y + 1) / float(GridY)) * sy;
+			for (uint32_t x = 0; x < GridX; ++x) {
+				float x0 = (-1.0f + 2.0f * x / float(GridX)) * sx;
+				float x1 = (-1.0f + 2.0f * (x + 1) / float(GridX)) * sx;
+				uint32_t i = x + GridX * (y + GridY * z);
+				//tiles widen with depth, so the bounds come from the corners on both depth planes:
+				min_x[i] = std::min(std::min(x0 * near_depth, x0 * far_depth_z), std::min(x1 * near_depth, x1 * far_depth_z));
+				max_x[i] = std::max(std::max(x0 * near_depth, x0 * far_depth_z), std::max(x1 * near_depth, x1 * far_depth_z));
+				min_y[i] = std::min(std::min(y0 * near_depth, y0 * far_depth_z), std::min(y1 * near_depth, y1 * far_depth_z));
+				max_y[i] = std::max(std::max(y0 * near_depth, y0 * far_depth_z), std::max(y1 * near_depth, y1 * far_depth_z));
+				//(cameras look along -z)
+				min_z[i] = -far_depth_z;
+				max_z[i] = -near_depth;
+			}
+		}
+	}
+}
+
+void LightClusters::update(Scene const &scene, Scene::Camera const *camera) {
+	GPUProfiler::Scope profile("LightClusters::update");
+	cull(scene, camera);
+	upload();
+}
+
+void LightClusters::cull(Scene const &scene, Scene::Camera const *camera) {
+	assert(camera && "Must have a camera to cluster lights for.");
+
+	if (camera->fovy != bounds_fovy || camera->aspect != bounds_aspect || camera->near != bounds_near
+	 || first_slice_depth != bounds_first_slice_depth || far_depth != bounds_far_depth) {
+		compute_bounds(camera);
+	}
+
+	glm::mat4 world_to_camera = camera->transform->make_world_to_local();
+
+	lights.clear();
+	pairs.clear();
+	light_count = 0;
+	bool overflow = false;
+
+	for (Scene::Lamp const &lamp : scene.lamps) {
+		if (lamp.type != Scene::Lamp::Point && lamp.type != Scene::Lamp::Spot) continue;
+		float radius = lamp.distance;
+		if (!(radius > 0.0f) || lamp.energy == 0.0f) continue;
+
+		glm::mat4 local_to_world = lamp.transform->make_local_to_world();
+		glm::vec3 world_position = glm::vec3(local_to_world[3]);
+		glm::vec3 center = glm::vec3(world_to_camera * glm::vec4(world_position, 1.0f));
+
+		//lamps entirely behind the camera or beyond the last slice can't light anything:
+		float depth = -center.z;
+		if (depth + radius <= camera->near || depth - radius >= far_depth) continue;
+
+		if (light_count == MaxLights) {
+			overflow = true;
+			break;
+		}
+		uint32_t index = light_count++;
+
+		bool spot = (lamp.type == Scene::Lamp::Spot);
+		glm::vec3 direction = -glm::normalize(glm::vec3(local_to_world[2]));
+		lights.emplace_back(world_position, radius);
+		lights.emplace_back(lamp.color * lamp.energy, spot ? 1.0f : 0.0f);
+		lights.emplace_back(direction, std::cos(0.5f * lamp.fov));
+
+		//test against every cluster in the slices the sphere spans:
+		uint32_t z_begin = slice(std::max(0.0f, depth - radius));
+		uint32_t z_end = slice(std::min(far_depth, depth + radius)) + 1;
+		float r2 = radius * radius;
+#ifdef LIGHTCLUSTERS_SSE
+		__m128 cx = _mm_set1_ps(center.x);
+		__m128 cy = _mm_set1_ps(center.y);
+		__m128 cz = _mm_set1_ps(center.z);
+		__m128 r2_4 = _mm_set1_ps(r2);
+		__m128 zero = _mm_setzero_ps();
+#endif
+		for (uint32_t z = z_begin; z < z_end; ++z) {
+			for (uint32_t y = 0; y < GridY; ++y) {
+				uint32_t row = GridX * (y + GridY * z);
+				for (uint32_t x = 0; x < GridX; x += 4) {
+					uint32_t i = row + x;
+					//squared distance from the center to each box is the sum of per-axis distances outside the box:
+#ifdef LIGHTCLUSTERS_SSE
+					__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&min_x[i]), cx), _mm_sub_ps(cx, _mm_loadu_ps(&max_x[i]))), zero);
+					__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&min_y[i]), cy), _mm_sub_ps(cy, _mm_loadu_ps(&max_y[i]))), zero);
+					__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&min_z[i]), cz), _mm_sub_ps(cz, _mm_loadu_ps(&max_z[i]))), zero);
+					__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+					int hits = _mm_movemask_ps(_mm_cmple_ps(d2, r2_4));
+#else
+					int hits = 0;
+					for (uint32_t j = 0; j < 4; ++j) {
+						float dx = std::max(std::max(min_x[i+j] - center.x, center.x - max_x[i+j]), 0.0f);
+						float dy = std::max(std::max(min_y[i+j] - center.y, center.y - max_y[i+j]), 0.0f);
+						float dz = std::max(std::max(min_z[i+j] - center.z, center.z - max_z[i+j]), 0.0f);
+						if (dx * dx + dy * dy + dz * dz <= r2) hits |= (1 << j);
+					}
+#endif
+					if (hits == 0) continue;
+					for (uint32_t j = 0; j < 4; ++j) {
+						if (hits & (1 << j)) pairs.emplace_back(i + j, index);
+					}
+				}
+			}
+		}
+	}
+
+	//counting sort of the (cluster, lamp) pairs into per-cluster ranges of the index list:
+	clusters.assign(ClusterCount, glm::uvec2(0));
+	for (auto const &p : pairs) {
+		clusters[p.x].y += 1;
+	}
+	uint32_t offset = 0;
+	for (auto &c : clusters) {
+		if (offset + c.y > MaxIndices) {
+			c.y = MaxIndices - offset;
+			overflow = true;
+		}
+		c.x = offset;
+		offset += c.y;
+	}
+	index_count = offset;
+	light_indices.resize(std::max(1U, index_count));
+	{ //fill ranges (pairs are in lamp order, so each cluster's lamps stay in lamp order):
+		fill.assign(ClusterCount, 0);
+		for (auto const &p : pairs) {
+			glm::uvec2 const &c = clusters[p.x];
+			if (fill[p.x] < c.y) {
+				light_indices[c.x + fill[p.x]] = p.y;
+				fill[p.x] += 1;
+			}
+		}
+	}
+
+	if (overflow && !warned_overflow) {
+		std::cerr << "WARNING: too many lamps for LightClusters; some lamps will not be drawn." << std::endl;
+		warned_overflow = true;
+	}
+
+	if (lights.empty()) lights.emplace_back(0.0f);
+}
+
+void LightClusters::upload() {
+	//(orphaning the old contents, which may still be in use by the previous frame)
+	GLState::bind_buffer(GL_TEXTURE_BUFFER, lights_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, lights.size() * sizeof(glm::vec4), lights.data(), GL_STREAM_DRAW);
+	GLState::bind_buffer(GL_TEXTURE_BUFFER, clusters_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, clusters.size() * sizeof(glm::uvec2), clusters.data(), GL_STREAM_DRAW);
+	GLState::bind_buffer(GL_TEXTURE_BUFFER, light_indices_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, light_indices.size() * sizeof(uint32_t), light_indices.data(), GL_STREAM_DRAW);
+}
+
+void LightClusters::bind(ShaderVariants::Program const &program) const {
+	float scale = float(GridZ - 1) / std::log(far_depth / first_slice_depth);
+	float bias = -std::log(first_slice_depth) * scale;
+	GLState::uniform(program.cluster_depth_vec4, glm::vec4(first_slice_depth, far_depth, scale, bias));
+
+	glActiveTexture(GL_TEXTURE0 + ShaderVariants::LightsUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, lights_tex);
+	glActiveTexture(GL_TEXTURE0 + ShaderVariants::ClustersUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, clusters_tex);
+	glActiveTexture(GL_TEXTURE0 + ShaderVariants::LightIndicesUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, light_indices_tex);
+	glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "GL.hpp"
+#include "Scene.hpp"
+#include "ShaderVariants.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+//LightClusters sorts a scene's point and spot lamps into a grid of view-space "froxels"
+// (GridX x GridY screen tiles, each split into GridZ depth slices) so that each fragment
+// drawn with the ShaderVariants::Clustered feature only evaluates the lamps that can reach it.
+//
+//Usage (each frame, before drawing the scene):
+// light_clusters.update(scene, camera); //gathers lamps, culls them into clusters, uploads
+// GLState::use_program(program.program); //(a variant with the Clustered feature)
+// light_clusters.bind(program);
+//
+//Lamps are treated as spheres of radius Lamp::distance (spot lamps included, conservatively).
+//Hemisphere and directional lamps light everything, so they aren't clustered; use the
+// program's sky and sun uniforms for those.
+//Depth slice 0 covers everything nearer than first_slice_depth; the remaining slices are spaced
+// exponentially out to far_depth. Nothing beyond far_depth is lit by clustered lamps.
+
+struct LightClusters {
+	static constexpr const uint32_t GridX = 16; //(must be a multiple of four)
+	static constexpr const uint32_t GridY = 9;
+	static constexpr const uint32_t GridZ = 24;
+	static constexpr const uint32_t ClusterCount = GridX * GridY * GridZ;
+	//capacity of the light index list; GL only guarantees buffer textures of this many texels:
+	static constexpr const uint32_t MaxIndices = 65536;
+	static constexpr const uint32_t MaxLights = MaxIndices / 3; //(three texels per lamp)
+
+	float first_slice_depth = 1.0f;
+	float far_depth = 100.0f;
+
+	LightClusters();
+	~LightClusters();
+	LightClusters(LightClusters const &) = delete;
+	LightClusters &operator=(LightClusters const &) = delete;
+
+	//gather the scene's lamps (as seen from 'camera') and cull them into clusters, then upload:
+	void update(Scene const &scene, Scene::Camera const *camera);
+	//...or in two steps; cull() doesn't call OpenGL, so it can run on another thread:
+	//(both use the world matrices from the scene's last update_transforms(), e.g. as called by Scene::extract)
+	void cull(Scene const &scene, Scene::Camera const *camera);
+	void upload();
+
+	//bind the cluster data and set the cluster uniforms on the current program:
+	// (program must be the current program)
+	void bind(ShaderVariants::Program const &program) const;
+
+	//statistics from the last update():
+	uint32_t light_count = 0; //lamps that were in view
+	uint32_t index_count = 0; //(lamp, cluster) pairs
+
+	//internals:
+	//view-space cluster bounds, in structure-of-arrays layout for SIMD testing (indexed by x + GridX * (y + GridY * z)):
+	std::vector< float > min_x, min_y, min_z, max_x, max_y, max_z;
+	//bounds above were computed for these camera parameters:
+	float bounds_fovy = 0.0f;
+	float bounds_aspect = 0.0f;
+	float bounds_near = 0.0f;
+	float bounds_first_slice_depth = 0.0f;
+	float bounds_far_depth = 0.0f;
+	void compute_bounds(Scene::Camera const *camera);
+	//the depth slice containing view depth 'depth':
+	uint32_t slice(float depth) const;
+
+	//cpu-side copies of the data uploaded to the buffers below:
+	std::vector< glm::vec4 > lights; //three per lamp (see ShaderVariants.cpp)
+	std::vector< glm::uvec2 > clusters; //(first index, count)
+	std::vector< uint32_t > light_indices;
+	//(cluster, lamp) pairs found by culling:
+	std::vector< glm::uvec2 > pairs;
+	std::vector< uint32_t > fill; //(per-cluster count while filling light_indices)
+
+	GLuint lights_buffer = 0, lights_tex = 0;
+	GLuint clusters_buffer = 0, clusters_tex = 0;
+	GLuint light_indices_buffer = 0, light_indices_tex = 0;
+	bool warned_overflow = false;
+};
@@ -21,16 +21,22 @@
  * These functions are grouped by 'tags', which allow some sequencing of calls.
  * (particularly, this is useful for loading large data blobs [e.g. "Meshes"] before looking up individual elements within them.)
  *
+ * Load functions may add more load functions (with add_load_function) for later tags.
+ * Shader programs use this to submit their sources in LoadTagShaders and only check
+ * the result in LoadTagLink, so the driver compiles them while LoadTagInit reads files.
+ *
  */
 
 #include <functional>
 #include <stdexcept>
 
 enum LoadTag : uint32_t {
-	LoadTagInit = 0, //used for loading mesh and texture blobs before main
-	LoadTagDefault = 1,
-	LoadTagLate = 2,
-	LoadTagCount = 3
+	LoadTagShaders = 0, //used for submitting shader programs, which then compile while the later tags run
+	LoadTagInit = 1, //used for loading mesh and texture blobs before main
+	LoadTagLink = 2, //used for checking programs submitted in LoadTagShaders and looking up their uniforms
+	LoadTagDefault = 3,
+	LoadTagLate = 4,
+	LoadTagCount = 5
 };
 
 void add_load_function(LoadTag tag, std::function< void() > const &fn);
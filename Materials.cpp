@@ -0,0 +1,166 @@
+#include "Materials.hpp"
+
+#include "ShaderVariants.hpp"
+#include "GLState.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+#include <stdexcept>
+
+namespace Materials {
+
+namespace {
+//local data:
+
+struct Store {
+	std::vector< Material > materials; //indexed by slot
+	std::vector< Texture const * > textures; //indexed by slot
+	std::vector< bool > live; //indexed by slot
+	std::vector< uint32_t > generations; //indexed by slot; incremented when a slot's material is destroyed
+	std::vector< uint32_t > free_slots;
+	bool dirty = true; //materials have changed since the last upload
+
+	//uniform buffer holding every material, 'stride' bytes apart:
+	GLuint ubo = 0;
+	GLsizeiptr stride = 0;
+	GLsizeiptr ubo_size = 0;
+	std::vector< uint8_t > staging;
+
+	Store() {
+		//the default material:
+		materials.emplace_back();
+		textures.emplace_back(nullptr);
+		live.emplace_back(true);
+		generations.emplace_back(0);
+	}
+};
+
+Store &get_store() {
+	static Store store;
+	return store;
+}
+
+void upload(Store &store) {
+	if (store.ubo == 0) {
+		glGenBuffers(1, &store.ubo);
+		//ranges bound with glBindBufferRange must start at multiples of this:
+		GLint alignment = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		alignment = std::max(alignment, 16);
+		store.stride = ((GLsizeiptr(sizeof(Material)) + alignment - 1) / alignment) * alignment;
+	}
+
+	store.staging.assign(store.materials.size() * store.stride, 0);
+	for (uint32_t i = 0; i < store.materials.size(); ++i) {
+		std::memcpy(&store.staging[i * store.stride], &store.materials[i], sizeof(Material));
+	}
+
+	//orphan the old contents (they may still be in use by earlier draws):
+	GLState::bind_buffer(GL_UNIFORM_BUFFER, store.ubo);
+	store.ubo_size = GLsizeiptr(store.staging.size());
+	glBufferData(GL_UNIFORM_BUFFER, store.ubo_size, store.staging.data(), GL_DYNAMIC_DRAW);
+
+	store.dirty = false;
+}
+
+} //end anon namespace
+
+//------------------
+
+ID create(Material const &material, Texture const *texture) {
+	Store &store = get_store();
+	uint32_t index;
+	if (!store.free_slots.empty()) {
+		index = store.free_slots.back();
+		store.free_slots.pop_back();
+	} else {
+		index = uint32_t(store.materials.size());
+		if (index >> IndexBits) throw std::runtime_error("Too many materials.");
+		store.materials.emplace_back();
+		store.textures.emplace_back(nullptr);
+		store.live.emplace_back(false);
+		store.generations.emplace_back(0);
+	}
+	store.materials[index] = material;
+	store.textures[index] = texture;
+	store.live[index] = true;
+	store.dirty = true;
+	return (store.generations[index] << IndexBits) | index;
+}
+
+void destroy(ID id) {
+	Store &store = get_store();
+	assert(id != Default && "The default material can't be destroyed.");
+	assert(valid(id) && "Destroying a material that doesn't exist.");
+	if (id == Default || !valid(id)) return;
+	uint32_t index = index_of(id);
+	store.live[index] = false;
+	store.textures[index] = nullptr;
+	//(generations wrap, so an ID is only detected as stale for the next 4095 reuses of its slot)
+	store.generations[index] = (store.generations[index] + 1) & ((1U << (32 - IndexBits)) - 1);
+	store.free_slots.emplace_back(index);
+}
+
+bool valid(ID id) {
+	Store &store = get_store();
+	uint32_t index = index_of(id);
+	return index < store.live.size() && store.live[index] && store.generations[index] == (id >> IndexBits);
+}
+
+Material const &get(ID id) {
+	Store &store = get_store();
+	assert(valid(id) && "Getting a material that doesn't exist.");
+	return store.materials[index_of(id)];
+}
+
+Material &edit(ID id) {
+	Store &store = get_store();
+	assert(valid(id) && "Editing a material that doesn't exist.");
+	store.dirty = true;
+	return store.materials[index_of(id)];
+}
+
+Texture const *texture(ID id) {
+	Store &store = get_store();
+	assert(valid(id) && "Getting a material that doesn't exist.");
+	return store.textures[index_of(id)];
+}
+
+void update() {
+	Store &store = get_store();
+	for (uint32_t i = 0; i < store.materials.size(); ++i) {
+		Texture const *tex = store.textures[i];
+		if (!tex) continue;
+		Material &material = store.materials[i];
+		if (material.uv_offset != tex->uv_offset || material.uv_scale != tex->uv_scale) {
+			material.uv_offset = tex->uv_offset;
+			material.uv_scale = tex->uv_scale;
+			store.dirty = true;
+		}
+	}
+	if (store.dirty) upload(store);
+}
+
+void bind(ID id) {
+	Store &store = get_store();
+	assert(valid(id) && "Binding a material that doesn't exist.");
+	if (!valid(id)) id = Default; //(rather than drawing with whatever material reused the slot)
+	uint32_t index = index_of(id);
+	if (store.dirty) upload(store);
+
+	GLState::bind_buffer_range(GL_UNIFORM_BUFFER, ShaderVariants::MaterialBinding, store.ubo, index * store.stride, sizeof(Material));
+
+	//(the texture name changes when the texture finishes loading, so it is always bound)
+	if (Texture const *tex = store.textures[index]) {
+		glActiveTexture(GL_TEXTURE0 + ShaderVariants::TextureUnit);
+		glBindTexture(GL_TEXTURE_2D, tex->tex);
+	}
+}
+
+uint32_t count() {
+	return uint32_t(get_store().materials.size());
+}
+
+} //namespace Materials
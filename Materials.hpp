@@ -0,0 +1,59 @@
+#pragma once
+
+#include "GL.hpp"
+#include "TextureCache.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+//"Material" is the per-material parameter block of the lit shader (see ShaderVariants.hpp).
+// It is plain data laid out to match the shader's std140 'Material' uniform block, so it can be
+// copied straight into a uniform buffer.
+struct Material {
+	glm::vec4 tint = glm::vec4(1.0f); //multiplied into vertex (and texture) color
+	//(Textured) texture coordinate transform; filled in from the material's texture:
+	glm::vec2 uv_offset = glm::vec2(0.0f);
+	glm::vec2 uv_scale = glm::vec2(1.0f);
+};
+static_assert(sizeof(Material) == 4*4 + 2*4 + 2*4, "Material matches its std140 layout.");
+
+//"Materials" stores every Material in one array (and one uniform buffer), referenced by ID.
+// Scene::Objects name their material by ID; Scene::draw sorts objects by program and material so
+// that each material is bound once per frame, by binding a range of the uniform buffer.
+//
+//Materials::Default (white tint, no texture) always exists; code drawing with a shader variant
+// outside of Scene::draw should bind a material first (e.g. Materials::bind(Materials::Default)).
+
+namespace Materials {
+
+//IDs are a slot index (low bits) and the slot's generation (high bits), so an ID kept after its
+// material is destroyed doesn't silently refer to whatever material reuses the slot:
+typedef uint32_t ID;
+constexpr const ID Default = 0;
+constexpr const uint32_t IndexBits = 20;
+inline uint32_t index_of(ID id) { return id & ((1U << IndexBits) - 1); }
+
+//create a material, optionally with a texture (from TextureCache; drawn with ShaderVariants::Textured):
+ID create(Material const &material = Material(), Texture const *texture = nullptr);
+//free a material's slot for reuse (Default can't be destroyed):
+void destroy(ID id);
+//does 'id' refer to a live material? (the functions below assert this; bind() falls back to Default when asserts are off)
+bool valid(ID id);
+
+Material const &get(ID id);
+//get a material for changing (it is uploaded again at the next update()):
+Material &edit(ID id);
+Texture const *texture(ID id);
+
+//copy texture coordinate transforms from textures (which change when they finish loading) and upload
+// changed materials; Scene::draw calls this before drawing:
+void update();
+
+//bind a material's range of the uniform buffer (and its texture) for drawing:
+void bind(ID id);
+
+//number of material slots (live or free):
+uint32_t count();
+
+} //namespace Materials
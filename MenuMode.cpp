@@ -4,9 +4,13 @@
 #include "compile_program.hpp"
 #include "MeshBuffer.hpp"
 #include "data_path.hpp"
+#include "GLState.hpp"
+#include "GPUProfiler.hpp"
+#include "FrameGraph.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 #include <cmath>
+#include <cassert>
 #include <iostream>
 
 //---------- resources ------------
@@ -19,8 +23,8 @@ Load< MeshBuffer > menu_meshes(LoadTagInit, [](){
 GLint menu_program_mvp = -1;
 GLint menu_program_color = -1;
 
-Load< GLuint > menu_program(LoadTagInit, [](){
-	GLuint *ret = new GLuint(compile_program(
+Load< GLuint > menu_program(LoadTagShaders, [](){
+	GLuint *ret = new GLuint(submit_program(
 		"#version 330\n"
 		"uniform mat4 mvp;\n"
 		"in vec4 Position;\n"
@@ -36,8 +40,11 @@ Load< GLuint > menu_program(LoadTagInit, [](){
 		"}\n"
 	));
 
-	menu_program_mvp = glGetUniformLocation(*ret, "mvp");
-	menu_program_color = glGetUniformLocation(*ret, "color");
+	add_load_function(LoadTagLink, [ret](){
+		finish_program(*ret);
+		menu_program_mvp = glGetUniformLocation(*ret, "mvp");
+		menu_program_color = glGetUniformLocation(*ret, "color");
+	});
 
 	return ret;
 });
@@ -47,10 +54,49 @@ Load< GLuint > menu_binding(LoadTagDefault, [](){
 	return new GLuint(menu_meshes->make_vao_for_program(*menu_program));
 });
 
+//Binding for drawing a fullscreen triangle from gl_VertexID (core profile needs some vertex array bound):
+Load< GLuint > empty_vao(LoadTagDefault, [](){
+	GLuint *ret = new GLuint(0);
+	glGenVertexArrays(1, ret);
+	return ret;
+});
+
+//composite_program draws the cached background texture with the fade color mixed over it:
+GLint composite_program_fade_vec4 = -1;
+GLint composite_program_tex_sampler2D = -1;
+
+Load< GLuint > composite_program(LoadTagShaders, [](){
+	GLuint *ret = new GLuint(submit_program(
+		"#version 330\n"
+		"void main() {\n"
+		"	gl_Position = vec4(4 * (gl_VertexID & 1) - 1,  2 * (gl_VertexID & 2) - 1, 0.0, 1.0);\n"
+		"}\n"
+	,
+		"#version 330\n"
+		"uniform sampler2D tex;\n"
+		"uniform vec4 fade;\n"
+		"out vec4 fragColor;\n"
+		"void main() {\n"
+		"	vec3 color = texelFetch(tex, ivec2(gl_FragCoord.xy), 0).rgb;\n"
+		"	fragColor = vec4(mix(color, fade.rgb, fade.a), 1.0);\n"
+		"}\n"
+	));
+
+	add_load_function(LoadTagLink, [ret](){
+		finish_program(*ret);
+		composite_program_fade_vec4 = glGetUniformLocation(*ret, "fade");
+		composite_program_tex_sampler2D = glGetUniformLocation(*ret, "tex");
+		GLState::use_program(*ret);
+		glUniform1i(composite_program_tex_sampler2D, 0);
+	});
+
+	return ret;
+});
+
 GLint fade_program_color = -1;
 
-Load< GLuint > fade_program(LoadTagInit, [](){
-	GLuint *ret = new GLuint(compile_program(
+Load< GLuint > fade_program(LoadTagShaders, [](){
+	GLuint *ret = new GLuint(submit_program(
 		"#version 330\n"
 		"void main() {\n"
 		"	gl_Position = vec4(4 * (gl_VertexID & 1) - 1,  2 * (gl_VertexID & 2) - 1, 0.0, 1.0);\n"
@@ -64,7 +110,10 @@ Load< GLuint > fade_program(LoadTagInit, [](){
 		"}\n"
 	));
 
-	fade_program_color = glGetUniformLocation(*ret, "color");
+	add_load_function(LoadTagLink, [ret](){
+		finish_program(*ret);
+		fade_program_color = glGetUniformLocation(*ret, "color");
+	});
 
 	return ret;
 });
@@ -72,6 +121,13 @@ Load< GLuint > fade_program(LoadTagInit, [](){
 
 //----------------------
 
+MenuMode::~MenuMode() {
+	if (background_color_tex) {
+		FrameGraph::forget_texture(background_color_tex);
+		glDeleteTextures(1, &background_color_tex);
+	}
+}
+
 bool MenuMode::handle_event(SDL_Event const &e, glm::uvec2 const &window_size) {
 	if (e.type == SDL_KEYDOWN) {
 		if (e.key.keysym.sym == SDLK_ESCAPE) {
@@ -113,22 +169,38 @@ void MenuMode::update(float elapsed) {
 }
 
 void MenuMode::draw(glm::uvec2 const &drawable_size) {
-	if (background && background_fade < 1.0f) {
+	//(a background that is still being updated has to be re-drawn to show its changes)
+	if (background && background_fade < 1.0f && cache_background && (background_size != drawable_size || background_time_scale != 0.0f)) {
+		render_background(drawable_size); //(turns off cache_background if the cache can't be created)
+	}
+
+	if (background && background_fade < 1.0f && cache_background) {
+		GPUProfiler::Scope profile("MenuMode fade");
+		GLState::disable(GL_DEPTH_TEST);
+		GLState::disable(GL_BLEND);
+		GLState::use_program(*composite_program);
+		GLState::uniform(composite_program_fade_vec4, glm::vec4(0.0f, 0.0f, 0.0f, background_fade));
+		GLState::bind_vertex_array(*empty_vao);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, background_color_tex);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	} else if (background && background_fade < 1.0f) {
 		background->draw(drawable_size);
 
-		glDisable(GL_DEPTH_TEST);
+		GLState::disable(GL_DEPTH_TEST);
 		if (background_fade > 0.0f) {
-			glEnable(GL_BLEND);
-			glBlendEquation(GL_FUNC_ADD);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glUseProgram(*fade_program);
-			glUniform4fv(fade_program_color, 1, glm::value_ptr(glm::vec4(0.0f, 0.0f, 0.0f, background_fade)));
+			GPUProfiler::Scope profile("MenuMode fade");
+			GLState::enable(GL_BLEND);
+			GLState::blend_equation(GL_FUNC_ADD);
+			GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			GLState::use_program(*fade_program);
+			GLState::uniform(fade_program_color, glm::vec4(0.0f, 0.0f, 0.0f, background_fade));
 			glDrawArrays(GL_TRIANGLES, 0, 3);
-			glUseProgram(0);
-			glDisable(GL_BLEND);
+			GLState::disable(GL_BLEND);
 		}
 	}
-	glDisable(GL_DEPTH_TEST);
+	GLState::disable(GL_DEPTH_TEST);
 
 	float aspect = drawable_size.x / float(drawable_size.y);
 	//scale factors such that a rectangle of aspect 'aspect' and height '1.0' fills the window:
@@ -145,8 +217,8 @@ void MenuMode::draw(glm::uvec2 const &drawable_size) {
 		total_height += choice.height + 2.0f * choice.padding;
 	}
 
-	glUseProgram(*menu_program);
-	glBindVertexArray(*menu_binding);
+	GLState::use_program(*menu_program);
+	GLState::bind_vertex_array(*menu_binding);
 
 	//character width and spacing helpers:
 	// (...in terms of the menu font's default 3-unit height)
@@ -198,8 +270,8 @@ void MenuMode::draw(glm::uvec2 const &drawable_size) {
 					glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
 					glm::vec4(s * x, y, 0.0f, 1.0f)
 				);
-				glUniformMatrix4fv(menu_program_mvp, 1, GL_FALSE, glm::value_ptr(mvp));
-				glUniform3f(menu_program_color, 1.0f, 1.0f, 1.0f);
+				GLState::uniform(menu_program_mvp, mvp);
+				GLState::uniform(menu_program_color, glm::vec3(1.0f, 1.0f, 1.0f));
 
 				MeshBuffer::Mesh const &mesh = menu_meshes->lookup(label.substr(i,1));
 				glDrawArrays(GL_TRIANGLES, mesh.start, mesh.count);
@@ -211,5 +283,48 @@ void MenuMode::draw(glm::uvec2 const &drawable_size) {
 		y -= choice.padding;
 	}
 
-	glEnable(GL_DEPTH_TEST);
+	GLState::enable(GL_DEPTH_TEST);
+}
+
+void MenuMode::render_background(glm::uvec2 const &drawable_size) {
+	assert(background);
+
+	//(re-)allocate the cache at the new size:
+	if (background_color_tex == 0) {
+		glGenTextures(1, &background_color_tex);
+	}
+	if (background_size != drawable_size) {
+		glBindTexture(GL_TEXTURE_2D, background_color_tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, drawable_size.x, drawable_size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	//draw into the cache (the depth buffer is only needed while drawing, so it is transient):
+	FrameGraph graph;
+	FrameGraph::Resource color = graph.import_texture("menu background", background_color_tex, FrameGraph::TextureDesc(drawable_size, GL_RGBA8));
+	FrameGraph::Resource depth = graph.create_texture("menu background depth", FrameGraph::TextureDesc(drawable_size, GL_DEPTH24_STENCIL8));
+	graph.add_pass("MenuMode background", [&](FrameGraph::Builder &pass){
+		pass.write(color);
+		pass.write(depth);
+	}, [&](FrameGraph const &){
+		//same default state as main() sets up before drawing a mode:
+		GLState::clear_color(glm::vec4(0.5f, 0.5f, 0.5f, 0.0f));
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		GLState::enable(GL_DEPTH_TEST);
+		GLState::enable(GL_BLEND);
+		GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		background->draw(drawable_size);
+	});
+	if (!graph.execute()) {
+		std::cerr << "WARNING: menu background framebuffer is incomplete; drawing the background every frame instead." << std::endl;
+		cache_background = false;
+		return;
+	}
+
+	background_size = drawable_size;
 }
@@ -1,13 +1,14 @@
 #pragma once
 
 #include "Mode.hpp"
+#include "GL.hpp"
 
 #include <functional>
 #include <vector>
 #include <string>
 
 struct MenuMode : public Mode {
-	virtual ~MenuMode() { }
+	virtual ~MenuMode();
 
 	virtual bool handle_event(SDL_Event const &event, glm::uvec2 const &window_size) override;
 	virtual void update(float elapsed) override;
@@ -29,4 +30,15 @@ struct MenuMode : public Mode {
 	std::shared_ptr< Mode > background;
 	float background_time_scale = 1.0f;
 	float background_fade = 0.5f;
+
+	//the background is drawn once into a texture (and again if the drawable size changes, or every
+	// frame while background_time_scale is non-zero), and that texture is composited each frame;
+	// set this to false if the background is expected to change while the menu is up for
+	// other reasons:
+	bool cache_background = true;
+
+	//internals for the cached background:
+	void render_background(glm::uvec2 const &drawable_size);
+	GLuint background_color_tex = 0;
+	glm::uvec2 background_size = glm::uvec2(0);
 };
@@ -1,5 +1,8 @@
 #include "MeshBuffer.hpp"
 #include "read_chunk.hpp"
+#include "GLState.hpp"
+#include "GeometryArena.hpp"
+#include "VertexLayout.hpp"
 
 #include <glm/glm.hpp>
 
@@ -11,104 +14,66 @@
 #include <set>
 #include <cstddef>
 
-MeshBuffer::MeshBuffer(std::string const &filename) {
-	glGenBuffers(1, &vbo);
-
-	std::ifstream file(filename, std::ios::binary);
-
-	GLuint total = 0;
-	//read + upload data chunk:
-	if (filename.size() >= 2 && filename.substr(filename.size()-2) == ".p") {
-		struct Vertex {
-			glm::vec3 Position;
-		};
-		static_assert(sizeof(Vertex) == 3*4, "Vertex is packed.");
-
-		std::vector< Vertex > data;
-		read_chunk(file, "p...", &data);
-
-		//upload data:
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		total = GLuint(data.size()); //store total for later checks on index
+namespace {
+	//vertex formats written by meshes/export-meshes.py:
+	namespace A = VertexAttribs;
+	typedef VertexLayout< A::Position > P;
+	typedef VertexLayout< A::Position, A::Normal > PN;
+	typedef VertexLayout< A::Position, A::Color > PC;
+	typedef VertexLayout< A::Position, A::TexCoord > PT;
+	typedef VertexLayout< A::Position, A::Normal, A::Color > PNC;
+	typedef VertexLayout< A::Position, A::Color, A::TexCoord > PCT;
+	typedef VertexLayout< A::Position, A::Normal, A::TexCoord > PNT;
+	typedef VertexLayout< A::Position, A::Normal, A::Color, A::TexCoord > PNCT;
+	//(check against the exporter's vertex sizes:)
+	static_assert(PNC::Stride == 3*4+3*4+4*1, "pnc vertex is packed");
+	static_assert(PNCT::Stride == 3*4+3*4+4*1+2*4, "pnct vertex is packed");
+
+	//read a vertex chunk and put it in the arena for its layout; returns the vertex count:
+	typedef GLuint (*VertexLoader)(MeshBuffer *buffer, std::istream &file);
+
+	template< typename Layout >
+	GLuint load_vertices(MeshBuffer *buffer, std::istream &file) {
+		std::vector< typename Layout::Vertex > data;
+		read_chunk(file, Layout::magic(), &data);
 
 		//store attrib locations:
-		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
-
-	} else if (filename.size() >= 3 && filename.substr(filename.size()-3) == ".pn") {
-		struct Vertex {
-			glm::vec3 Position;
-			glm::vec3 Normal;
-		};
-		static_assert(sizeof(Vertex) == 3*4+3*4, "Vertex is packed.");
-
-		std::vector< Vertex > data;
-		read_chunk(file, "pn..", &data);
-
-		//upload data:
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		total = GLuint(data.size()); //store total for later checks on index
-
-		//store attrib locations:
-		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
-		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
-
-	} else if (filename.size() >= 4 && filename.substr(filename.size()-4) == ".pnc") {
-		struct Vertex {
-			glm::vec3 Position;
-			glm::vec3 Normal;
-			glm::u8vec4 Color;
-		};
-		static_assert(sizeof(Vertex) == 3*4+3*4+4*1, "Vertex is packed.");
-
-		std::vector< Vertex > data;
-		read_chunk(file, "pnc.", &data);
+		Layout::set_attribs(buffer);
 
-		//upload data:
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		//upload data (into the arena shared by all buffers with this layout):
+		buffer->arena = &GeometryArena::for_layout(Layout::attribs());
+		buffer->allocation = buffer->arena->allocate(data.data(), GLuint(data.size()));
 
-		total = GLuint(data.size()); //store total for later checks on index
-
-		//store attrib locations:
-		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
-		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
-		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
-
-	} else if (filename.size() >= 4 && filename.substr(filename.size()-4) == ".pnct") {
-		struct Vertex {
-			glm::vec3 Position;
-			glm::vec3 Normal;
-			glm::u8vec4 Color;
-			glm::vec2 TexCoord;
-		};
-		static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
-
-		std::vector< Vertex > data;
-		read_chunk(file, "pnct", &data);
+		return GLuint(data.size());
+	}
 
-		//upload data:
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	template< typename... Layouts >
+	std::map< std::string, VertexLoader > make_loaders() {
+		return { { Layouts::extension(), &load_vertices< Layouts > }... };
+	}
 
-		total = GLuint(data.size()); //store total for later checks on index
+	//loaders by file extension:
+	std::map< std::string, VertexLoader > const &get_loaders() {
+		static std::map< std::string, VertexLoader > loaders = [](){
+			std::map< std::string, VertexLoader > ret = make_loaders< P, PN, PC, PT, PNC, PCT, PNT, PNCT >();
+			ret[".pl"] = &load_vertices< P >; //(line lists)
+			return ret;
+		}();
+		return loaders;
+	}
+}
 
-		//store attrib locations:
-		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
-		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
-		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
-		TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, TexCoord));
+MeshBuffer::MeshBuffer(std::string const &filename) {
+	std::ifstream file(filename, std::ios::binary);
 
-	} else {
+	//read + upload data chunk:
+	auto const &loaders = get_loaders();
+	auto dot = filename.rfind('.');
+	auto loader = loaders.find(dot == std::string::npos ? std::string() : filename.substr(dot));
+	if (loader == loaders.end()) {
 		throw std::runtime_error("Unknown file type '" + filename + "'");
 	}
+	GLuint total = loader->second(this, file); //store total for later checks on index
 
 	std::vector< char > strings;
 	read_chunk(file, "str0", &strings);
@@ -156,23 +121,33 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 	*/
 }
 
-const MeshBuffer::Mesh &MeshBuffer::lookup(std::string const &name) const {
+MeshBuffer::~MeshBuffer() {
+	if (arena) arena->free(allocation);
+}
+
+MeshBuffer::Mesh MeshBuffer::lookup(std::string const &name) const {
 	auto f = meshes.find(name);
 	if (f == meshes.end()) {
 		throw std::runtime_error("Looking up mesh '" + name + "' that doesn't exist.");
 	}
-	return f->second;
+	Mesh mesh = f->second;
+	mesh.start += arena->first(allocation);
+	return mesh;
 }
 
 GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
+	return arena->vao_for_program(program);
+}
+
+GLuint MeshBuffer::make_vao_for_attribs(GLuint program, GLuint vbo, std::vector< std::pair< char const *, Attrib > > const &attribs) {
 	//create a new vertex array object:
 	GLuint vao = 0;
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	GLState::bind_vertex_array(vao);
 
 	//Try to bind all attributes in this buffer:
 	std::set< GLuint > bound;
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	GLState::bind_buffer(GL_ARRAY_BUFFER, vbo);
 	auto bind_attribute = [&](char const *name, MeshBuffer::Attrib const &attrib) {
 		if (attrib.size == 0) return; //don't bind empty attribs
 		GLint location = glGetAttribLocation(program, name);
@@ -184,12 +159,9 @@ GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 			bound.insert(location);
 		}
 	};
-	bind_attribute("Position", Position);
-	bind_attribute("Normal", Normal);
-	bind_attribute("Color", Color);
-	bind_attribute("TexCoord", TexCoord);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	for (auto const &attrib : attribs) {
+		bind_attribute(attrib.first, attrib.second);
+	}
 
 	//Check that all active attributes were bound:
 	GLint active = 0;
@@ -2,12 +2,16 @@
 
 #include "GL.hpp"
 #include <map>
+#include <vector>
+#include <string>
+
+struct GeometryArena;
 
 //"MeshBuffer" holds a collection of meshes loaded from a file
-// (note that meshes in a single collection will share a vbo/vao)
+// (note that the vertices are stored in the GeometryArena for their layout, so meshes from all
+//  files with the same layout share a vbo/vao)
 
 struct MeshBuffer {
-	GLuint vbo = 0; //OpenGL vertex buffer object containing the meshes' data
 
 	//Attrib includes location within the vertex buffer of various attributes:
 	// (exactly the parameters to glVertexAttribPointer)
@@ -30,22 +34,34 @@ struct MeshBuffer {
 
 
 	//construct from a file:
+	// (the extension, e.g. ".pnc", gives the vertex layout; see VertexLayout.hpp)
 	// note: will throw if file fails to read.
 	MeshBuffer(std::string const &filename);
+	~MeshBuffer();
+	MeshBuffer(MeshBuffer const &) = delete;
+	MeshBuffer &operator=(MeshBuffer const &) = delete;
 
 	//look up a particular mesh in the DB:
 	// note: will throw if mesh not found.
+	// (start is an index into the arena's vbo; it changes if the arena is compacted)
 	struct Mesh {
 		GLuint start = 0;
 		GLuint count = 0;
 	};
-	const Mesh &lookup(std::string const &name) const;
+	Mesh lookup(std::string const &name) const;
 	
-	//build a vertex array object that links this vbo to attributes to a program:
+	//get a vertex array object that links the arena's vbo to attributes of a program:
+	//  (shared with other buffers of the same layout -- don't delete it)
 	//  will throw if program defines attributes not contained in this buffer
 	//  and warn if this buffer contains attributes not active in the program
 	GLuint make_vao_for_program(GLuint program) const;
 
+	//the same, for any buffer whose vertices are described by a list of (attribute name, Attrib) pairs
+	// (used by make_vao_for_program, and by other buffers with MeshBuffer-style layouts, e.g. StreamBuffer):
+	static GLuint make_vao_for_attribs(GLuint program, GLuint vbo, std::vector< std::pair< char const *, Attrib > > const &attribs);
+
 	//internals:
-	std::map< std::string, Mesh > meshes;
+	std::map< std::string, Mesh > meshes; //(starts relative to allocation)
+	GeometryArena *arena = nullptr;
+	uint32_t allocation = -1U;
 };
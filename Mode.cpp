@@ -1,8 +1,13 @@
 #include "Mode.hpp"
+#include "Jobs.hpp"
+
+#include <cassert>
 
 std::shared_ptr< Mode > Mode::current;
 
 void Mode::set_current(std::shared_ptr< Mode > const &new_current) {
+	//(main() reads 'current' while pipelined updates run on other threads)
+	assert(Jobs::on_main_thread() && "Mode::set_current must be called from the main thread.");
 	current = new_current;
 	//NOTE: may wish to, e.g., trigger resize events on new current mode.
 }
@@ -4,6 +4,7 @@
 #include <glm/glm.hpp>
 
 #include <memory>
+#include <cstdint>
 
 class Mode : public std::enable_shared_from_this< Mode > {
 public:
@@ -21,8 +22,23 @@ public:
 	//draw is called after update:
 	virtual void draw(glm::uvec2 const &drawable_size) = 0;
 
+	//Pipelining (optional; main() does this when run with --pipelined):
+	// a mode that returns true from 'pipelined' is drawn from snapshots of its state, so that
+	// the next frame's update can run on a worker thread while this frame is drawn.
+	// - extract is called right after update (on the same thread; and once before the first
+	//   pipelined frame), and copies what drawing needs into snapshot 'slot' (0 or 1);
+	//   'current' tells it whether the mode is Mode::current (so it needn't read that itself);
+	// - draw_snapshot is called on the main thread, and draws snapshot 'slot' while update and
+	//   extract fill the other one -- so it may only read the snapshot, and update and extract
+	//   must not call OpenGL (or read state that draw_snapshot changes), and must not call
+	//   Mode::set_current (change modes from handle_event, or queue it with Jobs::run_on_main).
+	// handle_event is never called while update runs.
+	virtual bool pipelined() const { return false; }
+	virtual void extract(uint32_t slot, glm::uvec2 const &drawable_size, bool current) { }
+	virtual void draw_snapshot(uint32_t slot, glm::uvec2 const &drawable_size) { }
+
 	//Mode::current is the Mode to which events are dispatched.
-	// use 'set_current' to change the current Mode (e.g., to switch to a menu)
+	// use 'set_current' to change the current Mode (e.g., to switch to a menu); main thread only
 	static std::shared_ptr< Mode > current;
 	static void set_current(std::shared_ptr< Mode > const &);
 };
@@ -0,0 +1,61 @@
+#include "Names.hpp"
+
+#include <unordered_map>
+#include <vector>
+#include <cassert>
+
+namespace Names {
+
+namespace {
+//local data:
+
+struct Table {
+	std::unordered_map< std::string, ID > ids;
+	std::vector< std::string const * > strings; //indexed by ID (points to keys of 'ids', which don't move)
+
+	Table() {
+		auto ret = ids.emplace(std::string(), None);
+		strings.emplace_back(&ret.first->first);
+	}
+};
+
+Table &get_table() {
+	static Table table;
+	return table;
+}
+
+} //end anon namespace
+
+//------------------
+
+ID intern(std::string const &name) {
+	Table &table = get_table();
+	auto ret = table.ids.emplace(name, ID(table.strings.size()));
+	if (ret.second) {
+		table.strings.emplace_back(&ret.first->first);
+	}
+	return ret.first->second;
+}
+
+ID intern(char const *begin, char const *end) {
+	return intern(std::string(begin, end));
+}
+
+ID find(std::string const &name) {
+	Table &table = get_table();
+	auto f = table.ids.find(name);
+	if (f == table.ids.end()) return None;
+	return f->second;
+}
+
+std::string const &string(ID id) {
+	Table &table = get_table();
+	assert(id < table.strings.size() && "Not an interned name.");
+	return *table.strings[id];
+}
+
+uint32_t count() {
+	return uint32_t(get_table().strings.size());
+}
+
+} //namespace Names
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+//"Names" interns strings: each distinct name is stored once and referred to by a 32-bit ID,
+// so names can be kept, compared, and hashed as integers (e.g. Scene::Transform::name).
+//
+//IDs are never freed, and are the same for the same string everywhere in the program.
+//Names::None (the empty string) always exists.
+
+namespace Names {
+
+typedef uint32_t ID;
+constexpr const ID None = 0;
+
+//ID for a name (interning it if it is new):
+ID intern(std::string const &name);
+ID intern(char const *begin, char const *end);
+
+//ID for a name that has already been interned, or None (e.g. for lookups, which shouldn't grow the table):
+ID find(std::string const &name);
+
+//the string an ID was interned from:
+std::string const &string(ID id);
+
+//number of interned names (including None):
+uint32_t count();
+
+} //namespace Names
@@ -12,11 +12,14 @@
 #include "data_path.hpp" //helper to get paths relative to executable
 #include "compile_program.hpp" //helper to compile opengl shader programs
 #include "draw_text.hpp" //helper to... um.. draw text
-#include "vertex_color_program.hpp"
+#include "ShaderVariants.hpp"
+#include "GLState.hpp"
+#include "DynamicResolution.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
 #include <iostream>
+#include <stdexcept>
 #include <fstream>
 #include <map>
 #include <cstddef>
@@ -29,20 +32,29 @@
 namespace NowYouHearMe
 {
 
-    Load< MeshBuffer > nyhm_meshes(LoadTagDefault, [](){
+    Load< MeshBuffer > nyhm_meshes(LoadTagInit, [](){
         return new MeshBuffer(data_path("nyhm.pnc"));
     });
 
-    Load< GLuint > nyhm_meshes_for_Vertex_color_program(LoadTagDefault, [](){
-        return new GLuint(nyhm_meshes->make_vao_for_program(vertex_color_program->program));
+    Load< ShaderVariants::Program > nyhm_program(LoadTagShaders, [](){
+        return ShaderVariants::load(ShaderVariants::Clustered);
     });
 
-    Load< Sound::Sample > sample_growl(LoadTagDefault, [](){
+    Load< GLuint > nyhm_meshes_for_nyhm_program(LoadTagDefault, [](){
+        return new GLuint(nyhm_meshes->make_vao_for_program(nyhm_program->program));
+    });
+
+    //(read once, and copied into the scene each time the mode starts)
+    Load< Scene::Prefab > nyhm_prefab(LoadTagInit, [](){
+        return new Scene::Prefab(data_path("nyhm.scene"));
+    });
+
+    Load< Sound::Sample > sample_growl(LoadTagInit, [](){
         return new Sound::Sample(data_path("monster_growl.wav"));
     });
 
     
-    Load< WalkMeshBuffer > walk_meshes(LoadTagDefault, [](){
+    Load< WalkMeshBuffer > walk_meshes(LoadTagInit, [](){
         return new WalkMeshBuffer(data_path("nyhm.pnt"));
     });
     
@@ -53,11 +65,8 @@ namespace NowYouHearMe
         auto attach_object = [this](Scene::Transform *transform, std::string const &name)
         {
             Scene::Object *object = scene.new_object(transform);
-            object->program = vertex_color_program->program;
-            object->program_mvp_mat4 = vertex_color_program->object_to_clip_mat4;
-            object->program_mv_mat4x3 = vertex_color_program->object_to_light_mat4x3;
-            object->program_itmv_mat3 = vertex_color_program->normal_to_light_mat3;
-            object->vao = *nyhm_meshes_for_Vertex_color_program;
+            object->variant = nyhm_program->key;
+            object->vao = *nyhm_meshes_for_nyhm_program;
             MeshBuffer::Mesh const &mesh = nyhm_meshes->lookup(name);
             object->start = mesh.start;
             object->count = mesh.count;
@@ -72,43 +81,43 @@ namespace NowYouHearMe
             );
         };
 
-        std::unordered_map<std::string, Scene::Transform*> name_to_trans = scene.load(data_path("nyhm.scene"));
+        scene.instantiate(*nyhm_prefab);
         
         walk_mesh = walk_meshes->lookup("WalkMesh");
 
-        auto it = name_to_trans.find("Walls");
-        if (it != name_to_trans.end()) {
-            attach_object(it->second, "Walls");
+        Scene::Transform *transform = scene.get_transform("Walls");
+        if (transform) {
+            attach_object(transform, "Walls");
         }
 
-        it = name_to_trans.find("Floor");
-        if (it != name_to_trans.end()) {
-            attach_object(it->second, "Floor");         
+        transform = scene.get_transform("Floor");
+        if (transform) {
+            attach_object(transform, "Floor");         
         }
 
-        it = name_to_trans.find("WalkMesh");
-        if (it != name_to_trans.end()) {
+        transform = scene.get_transform("WalkMesh");
+        if (transform) {
             // Turn on for debugging walkmesh
-            //attach_object(it->second, "WalkMesh");         
+            //attach_object(transform, "WalkMesh");         
         }
 
-        it = name_to_trans.find("Exit");
-        if (it != name_to_trans.end()) {
-            maze_exit = it->second;
+        transform = scene.get_transform("Exit");
+        if (transform) {
+            maze_exit = scene.handle(transform);
         }
 
-        it = name_to_trans.find("Player");
-        if (it != name_to_trans.end()) {
-            attach_object(it->second, "Player");
-            player = scene.get_object("Player");
-            player_start_position = it->second->position;
+        transform = scene.get_transform("Player");
+        if (transform) {
+            attach_object(transform, "Player");
+            player = scene.handle(scene.get_object("Player"));
+            player_start_position = transform->position;
             
 
-            player_walk_point = walk_mesh->start(player->transform->position);
+            player_walk_point = walk_mesh->start(scene.get(player)->transform->position);
             glm::vec3 world_point = walk_mesh->world_point(player_walk_point);
-            player->transform->position.x = world_point.x;
-            player->transform->position.y = world_point.y;
-            player->transform->position.z = world_point.z + 1.0f; // Keep the player above the ground
+            scene.get(player)->transform->position.x = world_point.x;
+            scene.get(player)->transform->position.y = world_point.y;
+            scene.get(player)->transform->position.z = world_point.z + 1.0f; // Keep the player above the ground
 
             //printf("Player landed on triangle: <%d, %d, %d>\n", player_walk_point.triangle.x, player_walk_point.triangle.y, player_walk_point.triangle.z);
             //printf("Its verts have the following coords:\n");
@@ -123,29 +132,35 @@ namespace NowYouHearMe
         }
 
         
-        it = name_to_trans.find("Monster");
-        if (it != name_to_trans.end()) {
-            monster_trans = it->second;
+        transform = scene.get_transform("Monster");
+        if (transform) {
+            monster_trans = scene.handle(transform);
             
             /* Debugging the monster's position
-            attach_object(it->second, "Monster");
-            monster = scene.get_object("Monster");
-            monster_walk_point = walk_mesh->start(monster_trans->position);
+            attach_object(transform, "Monster");
+            monster = scene.handle(scene.get_object("Monster"));
+            monster_walk_point = walk_mesh->start(scene.get(monster_trans)->position);
             glm::vec3 world_point = walk_mesh->world_point(monster_walk_point);
-            monster_trans->position.x = world_point.x;
-            monster_trans->position.y = world_point.y;
-            monster_trans->position.z = world_point.z + 1.0f; // Keep the player 2 units above the ground
+            scene.get(monster_trans)->position.x = world_point.x;
+            scene.get(monster_trans)->position.y = world_point.y;
+            scene.get(monster_trans)->position.z = world_point.z + 1.0f; // Keep the player 2 units above the ground
             */
         }
 
 
-        camera = scene.first_camera;
-        camera->transform->set_parent(player->transform);
-        camera->transform->position.z += 1.0f;
+        for (Scene::Camera &c : scene.cameras) {
+            camera = scene.handle(&c); //(the last camera in the scene)
+        }
+        scene.get(camera)->transform->set_parent(scene.get(player)->transform);
+        scene.get(camera)->transform->position.z += 1.0f;
+
+        //move the loaded scene into contiguous storage (pointers into it change; the handles above don't):
+        scene.compact();
 
         //std::cout << "End Mode Creation" << std::endl;
-        monster_growl = sample_growl->play(monster_trans->position - player->transform->position, 1.0f, Sound::Once);
+        monster_growl = sample_growl->play(scene.get(monster_trans)->position - scene.get(player)->transform->position, 1.0f, Sound::Once);
 
+        save(&start_state);
     }
 
     NowYouHearMeMode::~NowYouHearMeMode()
@@ -195,19 +210,19 @@ namespace NowYouHearMe
             }
             if (evt.type == SDL_MOUSEMOTION) {
                 //Note: float(window_size.y) * camera->fovy is a pixels-to-radians conversion factor
-                float yaw = evt.motion.xrel / float(window_size.y) * camera->fovy;
-                float pitch = evt.motion.yrel / float(window_size.y) * camera->fovy;
+                float yaw = evt.motion.xrel / float(window_size.y) * scene.get(camera)->fovy;
+                float pitch = evt.motion.yrel / float(window_size.y) * scene.get(camera)->fovy;
                 yaw = -yaw;
                 pitch = -pitch;
-                camera->transform->rotation = glm::normalize(
-                    camera->transform->rotation
+                scene.get(camera)->transform->rotation = glm::normalize(
+                    scene.get(camera)->transform->rotation
                     * glm::angleAxis(yaw, glm::vec3(0.0f, 1.0f, 0.0f))
                     * glm::angleAxis(pitch, glm::vec3(1.0f, 0.0f, 0.0f))
                 );
 
                 /* Playing around with different ways to rotate
-                player->transform->rotation = glm::normalize(
-                    player->transform->rotation
+                scene.get(player)->transform->rotation = glm::normalize(
+                    scene.get(player)->transform->rotation
                     * glm::angleAxis(yaw, glm::vec3(0.0f, 0.0f, 1.0f))
                     //* glm::angleAxis(pitch, glm::vec3(1.0f, 0.0f, 0.0f))
                 );
@@ -226,25 +241,21 @@ namespace NowYouHearMe
             if (caught_by_monster || at_exit) {
                 reset_timer -= elapsed;
                 if (reset_timer <= 0) {
-                    caught_by_monster = false;
-                    at_exit = false;
-                    std::cout << " === GAME OVER ===\nClosing game ..." << std::endl;
-                    Mode::set_current(nullptr);
+                    std::cout << " === GAME OVER ===\nRestarting ..." << std::endl;
+                    restore(start_state);
                 }
-                else {
-                    return;
-                }                
+                return;
             }
 
-            glm::vec3 distance_to_monster = monster_trans->position - player->transform->position;
+            glm::vec3 distance_to_monster = scene.get(monster_trans)->position - scene.get(player)->transform->position;
             caught_by_monster = glm::length(distance_to_monster) < 1.0f;
 
-            glm::vec3 distance_to_exit = maze_exit->position - player->transform->position;
+            glm::vec3 distance_to_exit = scene.get(maze_exit)->position - scene.get(player)->transform->position;
             at_exit = glm::length(distance_to_exit) < 1.25f;
         }
 
         { // Update the players position
-            glm::mat3 directions = glm::mat3_cast(camera->transform->rotation);
+            glm::mat3 directions = glm::mat3_cast(scene.get(camera)->transform->rotation);
 
             float move_speed = 5.0f;
 
@@ -264,9 +275,9 @@ namespace NowYouHearMe
                 walk_mesh->walk(player_walk_point, step);
                 glm::vec3 world_point = walk_mesh->world_point(player_walk_point);
 
-                player->transform->position.x = world_point.x;
-                player->transform->position.y = world_point.y;
-                player->transform->position.z = world_point.z + 1.0f; // Keep the player above the ground
+                scene.get(player)->transform->position.x = world_point.x;
+                scene.get(player)->transform->position.y = world_point.y;
+                scene.get(player)->transform->position.z = world_point.z + 1.0f; // Keep the player above the ground
             }
         }
         
@@ -274,51 +285,81 @@ namespace NowYouHearMe
             time_to_next_growl -= elapsed;
             if (time_to_next_growl <= 0)
             {
-                monster_growl = sample_growl->play(monster_trans->position - player->transform->position, 1.0f, Sound::Once);
+                monster_growl = sample_growl->play(scene.get(monster_trans)->position - scene.get(player)->transform->position, 1.0f, Sound::Once);
                 time_to_next_growl = MONSTER_GROWL_INTERVAL;
             }
         }
     }
 
-    // Contains code modified from CratesMode.cpp
     void NowYouHearMeMode::draw(glm::uvec2 const &drawable_size)
     {
-        //set up basic OpenGL state:
-        glEnable(GL_DEPTH_TEST);
-        glEnable(GL_BLEND);
-        glBlendEquation(GL_FUNC_ADD);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        extract(0, drawable_size, Mode::current.get() == this);
+        draw_snapshot(0, drawable_size);
+    }
 
-        //set up light position + color:
-        glUseProgram(vertex_color_program->program);
-        glUniform3fv(vertex_color_program->sun_color_vec3, 1, glm::value_ptr(glm::vec3(0.81f, 0.81f, 0.76f)));
-        glUniform3fv(vertex_color_program->sun_direction_vec3, 1, glm::value_ptr(glm::normalize(glm::vec3(-0.2f, 0.2f, 1.0f))));
-        glUniform3fv(vertex_color_program->sky_color_vec3, 1, glm::value_ptr(glm::vec3(0.4f, 0.4f, 0.45f)));
-        glUniform3fv(vertex_color_program->sky_direction_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 1.0f, 0.0f)));
-        glUseProgram(0);
+    void NowYouHearMeMode::extract(uint32_t slot, glm::uvec2 const &drawable_size, bool current)
+    {
+        Snapshot &snapshot = snapshots[slot];
+        Scene::Camera *cam = scene.get(camera);
 
         //fix aspect ratio of camera
-	    camera->aspect = drawable_size.x / float(drawable_size.y);
+        cam->aspect = drawable_size.x / float(drawable_size.y);
+
+        //(extract computes every transform's world matrices, which culling uses, so it goes first)
+        scene.extract(cam, &snapshot.draw_list);
+
+        //sort the scene's lamps into clusters for this view:
+        snapshot.light_clusters.cull(scene, cam);
 
-        scene.draw(camera);
+        snapshot.current = current;
+        snapshot.at_exit = at_exit;
+        snapshot.caught_by_monster = caught_by_monster;
+        snapshot.mouse_captured = mouse_captured;
+    }
+
+    // Contains code modified from CratesMode.cpp
+    void NowYouHearMeMode::draw_snapshot(uint32_t slot, glm::uvec2 const &drawable_size)
+    {
+        Snapshot &snapshot = snapshots[slot];
+
+        //set up basic OpenGL state:
+        GLState::enable(GL_DEPTH_TEST);
+        GLState::enable(GL_BLEND);
+        GLState::blend_equation(GL_FUNC_ADD);
+        GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        snapshot.light_clusters.upload();
+
+        //set up light position + color:
+        GLState::use_program(nyhm_program->program);
+        GLState::uniform(nyhm_program->sun_color_vec3, glm::vec3(0.81f, 0.81f, 0.76f));
+        GLState::uniform(nyhm_program->sun_direction_vec3, glm::normalize(glm::vec3(-0.2f, 0.2f, 1.0f)));
+        GLState::uniform(nyhm_program->sky_color_vec3, glm::vec3(0.4f, 0.4f, 0.45f));
+        GLState::uniform(nyhm_program->sky_direction_vec3, glm::vec3(0.0f, 1.0f, 0.0f));
+        snapshot.light_clusters.bind(*nyhm_program);
+
+        //the scene may be drawn at reduced resolution (text below is always drawn at full resolution):
+        DynamicResolution::draw_scene(drawable_size, [&snapshot](){
+            Scene::draw(snapshot.draw_list);
+        });
 
         GL_ERRORS();
 
-        if (Mode::current.get() == this) {
-            glDisable(GL_DEPTH_TEST);
+        if (snapshot.current) {
+            GLState::disable(GL_DEPTH_TEST);
             std::string message;
-            if (at_exit) {
+            if (snapshot.at_exit) {
                 message = "YOU LIVE";
                 float height = 0.1f;
                 float width = text_width(message, height);
                 draw_text(message, glm::vec2(-0.5f * width,-0.5f), height, glm::vec4(0.0f, 1.0f, 0.0f, 1.0f));
-            } else if (caught_by_monster) {
+            } else if (snapshot.caught_by_monster) {
                 message = "YOU DIED";
                 float height = 0.1f;
                 float width = text_width(message, height);
                 draw_text(message, glm::vec2(-0.5f * width,-0.5f), height, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
             } else {
-                if (mouse_captured) {
+                if (snapshot.mouse_captured) {
                     message = "ESCAPE TO UNGRAB MOUSE * WASD MOVE";
                 } else {
                     message = "CLICK TO GRAB MOUSE * ESCAPE QUIT";
@@ -328,20 +369,52 @@ namespace NowYouHearMe
                 draw_text(message, glm::vec2(-0.5f * width,-0.99f), height, glm::vec4(0.0f, 0.0f, 0.0f, 0.5f));
                 draw_text(message, glm::vec2(-0.5f * width,-1.0f), height, glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
             }
-            
-
-            glUseProgram(0);
 	    }
 
         GL_ERRORS();
     }
 
+    void NowYouHearMeMode::save(StateBlob *blob) const
+    {
+        blob->clear();
+        scene.save(blob);
+        blob->write(player_walk_point);
+        blob->write(monster_walk_point);
+        blob->write(time_to_next_growl);
+        blob->write(reset_timer);
+        blob->write(caught_by_monster);
+        blob->write(at_exit);
+        blob->write(monster_growl ? monster_growl->get_state() : Sound::PlayingSampleState());
+    }
+
+    void NowYouHearMeMode::restore(StateBlob const &blob)
+    {
+        StateBlob::Reader reader(blob);
+        scene.restore(reader);
+        reader.read(&player_walk_point);
+        reader.read(&monster_walk_point);
+        reader.read(&time_to_next_growl);
+        reader.read(&reset_timer);
+        reader.read(&caught_by_monster);
+        reader.read(&at_exit);
+        Sound::PlayingSampleState growl;
+        reader.read(&growl);
+        if (!reader.done()) {
+            throw std::runtime_error("NowYouHearMeMode snapshot has extra data (was it saved from something else?)");
+        }
+
+        //(in place, if there's a growl to reuse)
+        if (monster_growl) monster_growl->set_state(growl);
+        else monster_growl = sample_growl->play(growl);
+    }
+
     void NowYouHearMeMode::show_pause_menu()
     {
         std::shared_ptr< MenuMode > menu = std::make_shared< MenuMode >();
 
         std::shared_ptr< Mode > game = shared_from_this();
         menu->background = game;
+        menu->background_time_scale = 0.0f; //(paused; this also keeps the cached background accurate)
 
         menu->choices.emplace_back("PAUSED");
         menu->choices.emplace_back("RESUME", [game](){
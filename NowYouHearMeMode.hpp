@@ -5,8 +5,10 @@
 #include "MeshBuffer.hpp"
 #include "GL.hpp"
 #include "Scene.hpp"
+#include "LightClusters.hpp"
 #include "Sound.hpp"
 #include "WalkMesh.hpp"
+#include "StateBlob.hpp"
 
 #include <SDL.h>
 #include <glm/glm.hpp>
@@ -37,9 +39,19 @@ namespace NowYouHearMe
         //draw is called after update:
         virtual void draw(glm::uvec2 const &drawable_size) override;
 
+        //drawing is split into extract (no OpenGL) and draw_snapshot, so the mode can be pipelined:
+        virtual bool pipelined() const override { return true; }
+        virtual void extract(uint32_t slot, glm::uvec2 const &drawable_size, bool current) override;
+        virtual void draw_snapshot(uint32_t slot, glm::uvec2 const &drawable_size) override;
+
         //starts up a 'quit/resume' pause menu:
         void show_pause_menu();
 
+        //game state (scene, walk points, timers, growl) as a blob, e.g. for restarts or checkpoints:
+        // (restore only works on the mode the blob was saved from)
+        void save(StateBlob *blob) const;
+        void restore(StateBlob const &blob);
+
         struct {
             bool forward = false;
             bool backward = false;
@@ -50,15 +62,27 @@ namespace NowYouHearMe
         bool mouse_captured = false;
 
         Scene scene;
-        Scene::Camera *camera = nullptr;
-
-        Scene::Object *monster = nullptr;
-        Scene::Transform *monster_trans = nullptr;
+        //(scene things are referred to by handle, since Scene::compact moves them)
+        Scene::CameraHandle camera;
+
+        //everything draw_snapshot needs (two, so one can be drawn while the other is extracted):
+        struct Snapshot {
+            Scene::DrawList draw_list;
+            LightClusters light_clusters; //the scene's lamps, sorted for the Clustered shader variant
+            bool current = false; //this was Mode::current (so draws its text)
+            bool at_exit = false;
+            bool caught_by_monster = false;
+            bool mouse_captured = false;
+        };
+        Snapshot snapshots[2];
+
+        Scene::ObjectHandle monster;
+        Scene::TransformHandle monster_trans;
         const float MONSTER_GROWL_INTERVAL = 4.0f;
         float time_to_next_growl = MONSTER_GROWL_INTERVAL;
-        Scene::Object *player = nullptr;
+        Scene::ObjectHandle player;
 
-        Scene::Transform* maze_exit = nullptr;
+        Scene::TransformHandle maze_exit;
         glm::vec3 player_start_position;
 
         std::shared_ptr< Sound::PlayingSample > monster_growl;
@@ -73,5 +97,7 @@ namespace NowYouHearMe
         float GAME_OVER_RESET_TIME = 2.0f;
         float reset_timer = GAME_OVER_RESET_TIME;
 
+        StateBlob start_state; //saved once the level is set up; restored when the game ends
+
     };
 };
\ No newline at end of file
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include <new>
+#include <cstdint>
+#include <cassert>
+
+//"Pool< T >" allocates T's in slabs of SlabSize slots, keeping freed slots on a free list:
+// - create() and destroy() are O(1), and don't touch the heap unless a new slab is needed;
+// - iterating (range-for) visits live T's in slot order, slab by slab;
+// - clear() (or destroying the pool) destroys everything and releases all slabs at once.
+//Pointers to T's stay valid until they are destroyed or the pool is compact()'ed.
+//Handles (index + generation) stay valid through compact(), and get() detects handles to destroyed T's.
+//
+//Usage:
+// Pool< Thing > things;
+// Thing *thing = things.create(arguments...);
+// Pool< Thing >::Handle handle = things.handle(thing);
+// for (Thing &t : things) { ... }
+// things.destroy(thing);
+// assert(things.get(handle) == nullptr);
+
+template< typename T, uint32_t SlabSize = 256 >
+struct Pool {
+	Pool() = default;
+	Pool(Pool const &) = delete;
+	Pool &operator=(Pool const &) = delete;
+	~Pool() { clear(); }
+
+	struct Handle {
+		uint32_t index = -1U; //into ids
+		uint32_t generation = 0;
+		bool operator==(Handle const &o) const { return index == o.index && generation == o.generation; }
+		bool operator!=(Handle const &o) const { return !(*this == o); }
+	};
+
+	template< typename... Args >
+	T *create(Args&&... args) {
+		if (free_head == NoSlot) grow();
+		if (free_id == NoSlot) {
+			free_id = uint32_t(ids.size());
+			ids.emplace_back();
+		}
+		Slot &slot = get_slot(free_head);
+		T *t = new (&slot.storage) T(std::forward< Args >(args)...);
+		free_head = slot.next_free;
+		slot.live = true;
+		slot.id = free_id;
+		free_id = ids[slot.id].next_free;
+		ids[slot.id].slot = slot.index;
+		live_count += 1;
+		creates += 1;
+		return t;
+	}
+
+	void destroy(T *t) {
+		assert(t && "Destroying null.");
+		Slot &slot = slot_of(t);
+		assert(slot.live && "Destroying something that isn't live.");
+		t->~T();
+		slot.live = false;
+		slot.next_free = free_head;
+		free_head = slot.index;
+		release_id(slot.id);
+		live_count -= 1;
+		destroys += 1;
+	}
+
+	//destroy every live T and release all slabs (handles to them become stale):
+	void clear() {
+		for (auto &slab : slabs) {
+			for (Slot &slot : slab->slots) {
+				if (!slot.live) continue;
+				reinterpret_cast< T * >(&slot.storage)->~T();
+				release_id(slot.id);
+			}
+		}
+		slabs.clear();
+		free_head = NoSlot;
+		live_count = 0;
+	}
+
+	Handle handle(T const *t) const {
+		Handle ret;
+		ret.index = slot_of(t).id;
+		ret.generation = ids[ret.index].generation;
+		return ret;
+	}
+	//the T a handle refers to, or nullptr if it has been destroyed:
+	T *get(Handle const &h) const {
+		if (h.index >= ids.size() || ids[h.index].generation != h.generation || ids[h.index].slot == NoSlot) return nullptr;
+		return reinterpret_cast< T * >(&const_cast< Slot & >(get_slot(ids[h.index].slot)).storage);
+	}
+
+	//move every live T -- in the order given, which must list each of them once -- into as few
+	// (fresh) slabs as possible, then release the old slabs. Handles stay valid; pointers don't:
+	// 'relocated' is called with every (old, new) pointer pair after all T's have been moved
+	// and before the old ones are destroyed, to fix up pointers that reference them.
+	template< typename F >
+	void compact(std::vector< T * > const &order, F const &relocated) {
+		assert(order.size() == live_count && "Compaction order must list every live T.");
+		std::vector< std::unique_ptr< Slab > > old_slabs;
+		old_slabs.swap(slabs);
+		free_head = NoSlot;
+
+		uint32_t slab_count = (live_count + SlabSize - 1) / SlabSize;
+		for (uint32_t i = 0; i < slab_count; ++i) {
+			slabs.emplace_back(new Slab);
+			slab_allocations += 1;
+		}
+		std::vector< std::pair< T *, T * > > moves;
+		moves.reserve(order.size());
+		for (uint32_t i = 0; i < capacity(); ++i) {
+			Slot &slot = get_slot(i);
+			slot.index = i;
+			if (i < order.size()) {
+				Slot &old = slot_of(order[i]);
+				assert(old.live && "Compaction order must only contain live T's.");
+				T *t = new (&slot.storage) T(std::move(*order[i]));
+				slot.live = true;
+				slot.id = old.id;
+				ids[slot.id].slot = i;
+				moves.emplace_back(order[i], t);
+			} else {
+				slot.next_free = (i + 1 < capacity() ? i + 1 : NoSlot);
+				if (free_head == NoSlot) free_head = i;
+			}
+		}
+
+		relocated(moves);
+
+		for (auto const &move : moves) {
+			move.first->~T();
+		}
+		compactions += 1;
+	}
+
+	//make room for 'count' more T's, so that many create()s don't touch the heap:
+	void reserve(uint32_t count) {
+		while (capacity() - live_count < count) grow();
+	}
+
+	uint32_t size() const { return live_count; }
+	uint32_t capacity() const { return uint32_t(slabs.size()) * SlabSize; }
+
+	//statistics, for checking heap traffic (slab allocations should stop once a scene is loaded):
+	uint32_t slab_allocations = 0;
+	uint32_t creates = 0;
+	uint32_t destroys = 0;
+	uint32_t compactions = 0;
+
+	//internals:
+	static constexpr const uint32_t NoSlot = -1U;
+	struct Slot {
+		typename std::aligned_storage< sizeof(T), alignof(T) >::type storage; //(first, so a T * is a Slot *)
+		uint32_t index = 0;
+		uint32_t id = NoSlot; //(when live) index into ids
+		uint32_t next_free = NoSlot; //(when not live)
+		bool live = false;
+	};
+	static_assert(std::is_standard_layout< Slot >::value, "Slot storage is at the start of a slot.");
+	struct Slab {
+		Slot slots[SlabSize];
+	};
+	std::vector< std::unique_ptr< Slab > > slabs;
+	uint32_t free_head = NoSlot;
+	uint32_t live_count = 0;
+
+	//handle indices -> slots (handles don't use slot indices directly, so T's can move):
+	struct Id {
+		uint32_t generation = 0; //incremented when the T is destroyed
+		uint32_t slot = NoSlot;
+		uint32_t next_free = NoSlot; //(when slot == NoSlot)
+	};
+	std::vector< Id > ids;
+	uint32_t free_id = NoSlot;
+
+	void release_id(uint32_t id) {
+		ids[id].generation += 1;
+		ids[id].slot = NoSlot;
+		ids[id].next_free = free_id;
+		free_id = id;
+	}
+
+	Slot &get_slot(uint32_t index) { return slabs[index / SlabSize]->slots[index % SlabSize]; }
+	Slot const &get_slot(uint32_t index) const { return slabs[index / SlabSize]->slots[index % SlabSize]; }
+	static Slot &slot_of(T *t) { return *reinterpret_cast< Slot * >(t); }
+	static Slot const &slot_of(T const *t) { return *reinterpret_cast< Slot const * >(t); }
+
+	void grow() {
+		uint32_t first = capacity();
+		slabs.emplace_back(new Slab);
+		slab_allocations += 1;
+		//chain the new slots so that lower indices are used first:
+		Slab &slab = *slabs.back();
+		for (uint32_t i = 0; i < SlabSize; ++i) {
+			slab.slots[i].index = first + i;
+			slab.slots[i].next_free = (i + 1 < SlabSize ? first + i + 1 : free_head);
+		}
+		free_head = first;
+	}
+
+	//iteration over live T's:
+	template< typename P, typename V >
+	struct Iterator {
+		P *pool;
+		uint32_t index;
+		V &operator*() const { return *reinterpret_cast< V * >(&pool->get_slot(index).storage); }
+		V *operator->() const { return &**this; }
+		Iterator &operator++() {
+			index += 1;
+			skip();
+			return *this;
+		}
+		bool operator!=(Iterator const &o) const { return index != o.index; }
+		bool operator==(Iterator const &o) const { return index == o.index; }
+		void skip() {
+			while (index < pool->capacity() && !pool->get_slot(index).live) index += 1;
+		}
+	};
+	typedef Iterator< Pool, T > iterator;
+	typedef Iterator< Pool const, T const > const_iterator;
+	iterator begin() { iterator it{this, 0}; it.skip(); return it; }
+	iterator end() { return iterator{this, capacity()}; }
+	const_iterator begin() const { const_iterator it{this, 0}; it.skip(); return it; }
+	const_iterator end() const { return const_iterator{this, capacity()}; }
+};
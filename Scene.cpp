@@ -1,5 +1,8 @@
 #include "Scene.hpp"
 #include "read_chunk.hpp"
+#include "GLState.hpp"
+#include "GPUProfiler.hpp"
+#include "Jobs.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -13,8 +16,14 @@
 #include <set>
 #include <cstddef>
 #include <map>
+#include <algorithm>
 #include <unordered_map>
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SCENE_SSE 1
+#endif
+
 glm::mat4 Scene::Transform::make_local_to_parent() const {
 	return glm::mat4( //translate
 		glm::vec4(1.0f, 0.0f, 0.0f, 0.0f),
@@ -52,19 +61,17 @@ glm::mat4 Scene::Transform::make_parent_to_local() const {
 }
 
 glm::mat4 Scene::Transform::make_local_to_world() const {
-	if (parent) {
-		return parent->make_local_to_world() * make_local_to_parent();
-	} else {
-		return make_local_to_parent();
-	}
+	TransformArrays const &arrays = scene->transform_arrays;
+	assert(arrays.hierarchy_version == scene->hierarchy_version && index < arrays.transforms.size() && arrays.transforms[index] == this
+		&& "World matrices are looked up in transform_arrays, so update_transforms() must be called after creating or re-parenting transforms.");
+	return arrays.local_to_world[index];
 }
 
 glm::mat4 Scene::Transform::make_world_to_local() const {
-	if (parent) {
-		return make_parent_to_local() * parent->make_world_to_local();
-	} else {
-		return make_parent_to_local();
-	}
+	TransformArrays const &arrays = scene->transform_arrays;
+	assert(arrays.hierarchy_version == scene->hierarchy_version && index < arrays.transforms.size() && arrays.transforms[index] == this
+		&& "World matrices are looked up in transform_arrays, so update_transforms() must be called after creating or re-parenting transforms.");
+	return arrays.world_to_local[index];
 }
 
 void Scene::Transform::DEBUG_assert_valid_pointers() const {
@@ -86,6 +93,7 @@ void Scene::Transform::DEBUG_assert_valid_pointers() const {
 void Scene::Transform::set_parent(Transform *new_parent, Transform *before) {
 	DEBUG_assert_valid_pointers();
 	assert(before == nullptr || (new_parent != nullptr && before->parent == new_parent));
+	assert((new_parent == nullptr || new_parent->scene == scene) && "Transforms can't be parented across scenes.");
 	if (parent) {
 		//remove from existing parent:
 		if (prev_sibling) prev_sibling->next_sibling = next_sibling;
@@ -94,6 +102,7 @@ void Scene::Transform::set_parent(Transform *new_parent, Transform *before) {
 		next_sibling = prev_sibling = nullptr;
 	}
 	parent = new_parent;
+	scene->hierarchy_version += 1;
 	if (parent) {
 		//add to new parent:
 		if (before) {
@@ -117,105 +126,368 @@ glm::mat4 Scene::Camera::make_projection() const {
 
 //---------------------------
 
-//templated helper functions to avoid having to write the same new/delete code three times:
-template< typename T, typename... Args >
-T *list_new(T * &first, Args&&... args) {
-	T *t = new T(std::forward< Args >(args)...); //"perfect forwarding"
-	if (first) {
-		t->alloc_next = first;
-		first->alloc_prev_next = &t->alloc_next;
-	}
-	t->alloc_prev_next = &first;
-	first = t;
-	return t;
-}
-
-template< typename T >
-void list_delete(T * t) {
-	assert(t && "It is invalid to delete a null scene object [yes this is different than 'delete']");
-	assert(t->alloc_prev_next);
-	if (t->alloc_next) {
-		t->alloc_next->alloc_prev_next = t->alloc_prev_next;
-	}
-	*t->alloc_prev_next = t->alloc_next;
-	//PARANOIA:
-	t->alloc_next = nullptr;
-	t->alloc_prev_next = nullptr;
-}
-
 Scene::Transform *Scene::new_transform() {
-	return list_new< Scene::Transform >(first_transform);
+	hierarchy_version += 1;
+	return transforms.create(this);
 }
 
 void Scene::delete_transform(Scene::Transform *transform) {
-	list_delete< Scene::Transform >(transform);
+	hierarchy_version += 1;
+	set_name(transform, Names::None);
+	transforms.destroy(transform);
 }
 
 Scene::Object *Scene::new_object(Scene::Transform *transform) {
 	assert(transform && "Scene::Object must be attached to a transform.");
-	return list_new< Scene::Object >(first_object, transform);
+	Object *object = objects.create(transform);
+	objects_by_transform.emplace(handle(transform).index, handle(object));
+	return object;
 }
 
 void Scene::delete_object(Scene::Object *object) {
-	list_delete< Scene::Object >(object);
+	ObjectHandle h = handle(object);
+	auto range = objects_by_transform.equal_range(handle(object->transform).index);
+	for (auto i = range.first; i != range.second; ++i) {
+		if (i->second == h) {
+			objects_by_transform.erase(i);
+			break;
+		}
+	}
+	objects.destroy(object);
 }
 
 Scene::Camera *Scene::new_camera(Scene::Transform *transform) {
 	assert(transform && "Scene::Camera must be attached to a transform.");
-	return list_new< Scene::Camera >(first_camera, transform);
+	return cameras.create(transform);
 }
 
 void Scene::delete_camera(Scene::Camera *object) {
-	list_delete< Scene::Camera >(object);
+	cameras.destroy(object);
 }
 
-void Scene::draw(Scene::Camera const *camera) {
+Scene::Lamp *Scene::new_lamp(Scene::Transform *transform) {
+	assert(transform && "Scene::Lamp must be attached to a transform.");
+	return lamps.create(transform);
+}
+
+void Scene::delete_lamp(Scene::Lamp *lamp) {
+	lamps.destroy(lamp);
+}
+
+#ifdef SCENE_SSE
+//write column 'c' of four consecutive matrices, given (x,y,z,w) of that column for each in the lanes of x,y,z,w:
+static inline void store_columns(glm::mat4 *mats, uint32_t c, __m128 x, __m128 y, __m128 z, __m128 w) {
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	_mm_storeu_ps(&mats[0][c][0], x);
+	_mm_storeu_ps(&mats[1][c][0], y);
+	_mm_storeu_ps(&mats[2][c][0], z);
+	_mm_storeu_ps(&mats[3][c][0], w);
+}
+
+//out = a * b (out must not be a or b):
+static inline void multiply(glm::mat4 const &a, glm::mat4 const &b, glm::mat4 &out) {
+	__m128 a0 = _mm_loadu_ps(&a[0][0]);
+	__m128 a1 = _mm_loadu_ps(&a[1][0]);
+	__m128 a2 = _mm_loadu_ps(&a[2][0]);
+	__m128 a3 = _mm_loadu_ps(&a[3][0]);
+	for (uint32_t c = 0; c < 4; ++c) {
+		__m128 col = _mm_mul_ps(a0, _mm_set1_ps(b[c][0]));
+		col = _mm_add_ps(col, _mm_mul_ps(a1, _mm_set1_ps(b[c][1])));
+		col = _mm_add_ps(col, _mm_mul_ps(a2, _mm_set1_ps(b[c][2])));
+		col = _mm_add_ps(col, _mm_mul_ps(a3, _mm_set1_ps(b[c][3])));
+		_mm_storeu_ps(&out[c][0], col);
+	}
+}
+#endif
+
+void Scene::update_transforms() {
+	TransformArrays &arrays = transform_arrays;
+
+	//re-order (depth-first from each root, so parents come before their children) if the hierarchy changed:
+	if (arrays.hierarchy_version != hierarchy_version) {
+		arrays.transforms.clear();
+		arrays.parents.clear();
+		std::vector< Transform * > todo;
+		for (Transform &transform : transforms) {
+			if (transform.parent) continue;
+			todo.emplace_back(&transform);
+			while (!todo.empty()) {
+				Transform *t = todo.back();
+				todo.pop_back();
+				t->index = uint32_t(arrays.transforms.size());
+				arrays.transforms.emplace_back(t);
+				arrays.parents.emplace_back(t->parent ? t->parent->index : -1U);
+				for (Transform *child = t->last_child; child != nullptr; child = child->prev_sibling) {
+					todo.emplace_back(child);
+				}
+			}
+		}
+
+		//padding entries are identity transforms (so the SIMD pass doesn't compute garbage):
+		uint32_t padded = (uint32_t(arrays.transforms.size()) + 3) & ~3U;
+		for (auto array : { &arrays.position_x, &arrays.position_y, &arrays.position_z,
+			&arrays.rotation_x, &arrays.rotation_y, &arrays.rotation_z }) {
+			array->assign(padded, 0.0f);
+		}
+		for (auto array : { &arrays.rotation_w, &arrays.scale_x, &arrays.scale_y, &arrays.scale_z }) {
+			array->assign(padded, 1.0f);
+		}
+		for (auto array : { &arrays.local_to_parent, &arrays.parent_to_local, &arrays.local_to_world, &arrays.world_to_local }) {
+			array->resize(padded);
+		}
+		arrays.hierarchy_version = hierarchy_version;
+	}
+
+	uint32_t count = uint32_t(arrays.transforms.size());
+
+	//each transform's local specification and matrices are independent of the others, so they are
+	// computed in parallel (in chunks that are multiples of four, for the SIMD loop):
+	Jobs::parallel_for(0, count, 1024, [&arrays](uint32_t begin, uint32_t end) {
+		//copy local specifications:
+		for (uint32_t i = begin; i < end; ++i) {
+			Transform const &t = *arrays.transforms[i];
+			arrays.position_x[i] = t.position.x;
+			arrays.position_y[i] = t.position.y;
+			arrays.position_z[i] = t.position.z;
+			arrays.rotation_x[i] = t.rotation.x;
+			arrays.rotation_y[i] = t.rotation.y;
+			arrays.rotation_z[i] = t.rotation.z;
+			arrays.rotation_w[i] = t.rotation.w;
+			arrays.scale_x[i] = t.scale.x;
+			arrays.scale_y[i] = t.scale.y;
+			arrays.scale_z[i] = t.scale.z;
+		}
+
+		//local matrices, as in make_local_to_parent() and make_parent_to_local()
+		// (assuming unit-length rotations, so the inverse rotation is the transpose):
+#ifdef SCENE_SSE
+		__m128 const zero = _mm_setzero_ps();
+		__m128 const one = _mm_set1_ps(1.0f);
+		__m128 const two = _mm_set1_ps(2.0f);
+		for (uint32_t i = begin; i < end; i += 4) {
+			__m128 px = _mm_loadu_ps(&arrays.position_x[i]);
+			__m128 py = _mm_loadu_ps(&arrays.position_y[i]);
+			__m128 pz = _mm_loadu_ps(&arrays.position_z[i]);
+			__m128 qx = _mm_loadu_ps(&arrays.rotation_x[i]);
+			__m128 qy = _mm_loadu_ps(&arrays.rotation_y[i]);
+			__m128 qz = _mm_loadu_ps(&arrays.rotation_z[i]);
+			__m128 qw = _mm_loadu_ps(&arrays.rotation_w[i]);
+			__m128 sx = _mm_loadu_ps(&arrays.scale_x[i]);
+			__m128 sy = _mm_loadu_ps(&arrays.scale_y[i]);
+			__m128 sz = _mm_loadu_ps(&arrays.scale_z[i]);
+
+			//rotation matrix, r<column><row>:
+			__m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+			__m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+			__m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+			__m128 r00 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+			__m128 r01 = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+			__m128 r02 = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+			__m128 r10 = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+			__m128 r11 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+			__m128 r12 = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+			__m128 r20 = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+			__m128 r21 = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+			__m128 r22 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+			//local to parent = translate * rotate * scale:
+			glm::mat4 *local = &arrays.local_to_parent[i];
+			store_columns(local, 0, _mm_mul_ps(r00, sx), _mm_mul_ps(r01, sx), _mm_mul_ps(r02, sx), zero);
+			store_columns(local, 1, _mm_mul_ps(r10, sy), _mm_mul_ps(r11, sy), _mm_mul_ps(r12, sy), zero);
+			store_columns(local, 2, _mm_mul_ps(r20, sz), _mm_mul_ps(r21, sz), _mm_mul_ps(r22, sz), zero);
+			store_columns(local, 3, px, py, pz, one);
+
+			//parent to local = un-scale * un-rotate * un-translate (zero scales un-scale to zero):
+			__m128 ix = _mm_and_ps(_mm_cmpneq_ps(sx, zero), _mm_div_ps(one, sx));
+			__m128 iy = _mm_and_ps(_mm_cmpneq_ps(sy, zero), _mm_div_ps(one, sy));
+			__m128 iz = _mm_and_ps(_mm_cmpneq_ps(sz, zero), _mm_div_ps(one, sz));
+			__m128 tx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r00, px), _mm_mul_ps(r01, py)), _mm_mul_ps(r02, pz));
+			__m128 ty = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r10, px), _mm_mul_ps(r11, py)), _mm_mul_ps(r12, pz));
+			__m128 tz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r20, px), _mm_mul_ps(r21, py)), _mm_mul_ps(r22, pz));
+			glm::mat4 *inv = &arrays.parent_to_local[i];
+			store_columns(inv, 0, _mm_mul_ps(ix, r00), _mm_mul_ps(iy, r10), _mm_mul_ps(iz, r20), zero);
+			store_columns(inv, 1, _mm_mul_ps(ix, r01), _mm_mul_ps(iy, r11), _mm_mul_ps(iz, r21), zero);
+			store_columns(inv, 2, _mm_mul_ps(ix, r02), _mm_mul_ps(iy, r12), _mm_mul_ps(iz, r22), zero);
+			store_columns(inv, 3, _mm_sub_ps(zero, _mm_mul_ps(ix, tx)), _mm_sub_ps(zero, _mm_mul_ps(iy, ty)), _mm_sub_ps(zero, _mm_mul_ps(iz, tz)), one);
+		}
+#else
+		for (uint32_t i = begin; i < end; ++i) {
+			glm::vec3 position(arrays.position_x[i], arrays.position_y[i], arrays.position_z[i]);
+			glm::quat rotation(arrays.rotation_w[i], arrays.rotation_x[i], arrays.rotation_y[i], arrays.rotation_z[i]);
+			glm::vec3 scale(arrays.scale_x[i], arrays.scale_y[i], arrays.scale_z[i]);
+			glm::mat3 r = glm::mat3_cast(rotation);
+			glm::vec3 inv_scale;
+			inv_scale.x = (scale.x == 0.0f ? 0.0f : 1.0f / scale.x);
+			inv_scale.y = (scale.y == 0.0f ? 0.0f : 1.0f / scale.y);
+			inv_scale.z = (scale.z == 0.0f ? 0.0f : 1.0f / scale.z);
+			arrays.local_to_parent[i] = glm::mat4(
+				glm::vec4(r[0] * scale.x, 0.0f),
+				glm::vec4(r[1] * scale.y, 0.0f),
+				glm::vec4(r[2] * scale.z, 0.0f),
+				glm::vec4(position, 1.0f)
+			);
+			glm::mat3 inv = glm::mat3(
+				glm::vec3(inv_scale.x, 0.0f, 0.0f),
+				glm::vec3(0.0f, inv_scale.y, 0.0f),
+				glm::vec3(0.0f, 0.0f, inv_scale.z)
+			) * glm::transpose(r);
+			arrays.parent_to_local[i] = glm::mat4(
+				glm::vec4(inv[0], 0.0f),
+				glm::vec4(inv[1], 0.0f),
+				glm::vec4(inv[2], 0.0f),
+				glm::vec4(-(inv * position), 1.0f)
+			);
+		}
+#endif
+	});
+
+	//world matrices, in one pass (parents are always computed before their children):
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t parent = arrays.parents[i];
+		if (parent == -1U) {
+			arrays.local_to_world[i] = arrays.local_to_parent[i];
+			arrays.world_to_local[i] = arrays.parent_to_local[i];
+		} else {
+#ifdef SCENE_SSE
+			multiply(arrays.local_to_world[parent], arrays.local_to_parent[i], arrays.local_to_world[i]);
+			multiply(arrays.parent_to_local[i], arrays.world_to_local[parent], arrays.world_to_local[i]);
+#else
+			arrays.local_to_world[i] = arrays.local_to_world[parent] * arrays.local_to_parent[i];
+			arrays.world_to_local[i] = arrays.parent_to_local[i] * arrays.world_to_local[parent];
+#endif
+		}
+	}
+}
+
+void Scene::extract(Scene::Camera const *camera, Scene::DrawList *list) {
 	assert(camera && "Must have a camera to draw scene from.");
+	assert(list);
 
-	glm::mat4 world_to_camera = camera->transform->make_world_to_local();
+	//compute every transform's world matrices (found by index in transform_arrays):
+	update_transforms();
+
+	glm::mat4 world_to_camera = transform_arrays.world_to_local[camera->transform->index];
 	glm::mat4 world_to_clip = camera->make_projection() * world_to_camera;
 
-	for (Scene::Object *object = first_object; object != nullptr; object = object->alloc_next) {
-		glm::mat4 local_to_world = object->transform->make_local_to_world();
+	list->draws.clear();
+	for (Scene::Object const &object : objects) {
+		list->draws.emplace_back();
+		DrawList::Draw &draw = list->draws.back();
+		draw.variant = object.variant;
+		draw.program = object.program;
+		draw.program_mvp_mat4 = object.program_mvp_mat4;
+		draw.program_mv_mat4x3 = object.program_mv_mat4x3;
+		draw.program_itmv_mat3 = object.program_itmv_mat3;
+		draw.material = object.material;
+		draw.vao = object.vao;
+		draw.start = object.start;
+		draw.count = object.count;
+
+		glm::mat4 const &local_to_world = transform_arrays.local_to_world[object.transform->index];
 
 		//compute modelview+projection (object space to clip space) matrix for this object:
-		glm::mat4 mvp = world_to_clip * local_to_world;
+		draw.mvp = world_to_clip * local_to_world;
 
 		//compute modelview (object space to camera local space) matrix for this object:
-		glm::mat4 mv = local_to_world;
+		draw.mv = glm::mat4x3(local_to_world);
 
 		//NOTE: inverse cancels out transpose unless there is scale involved
-		glm::mat3 itmv = glm::inverse(glm::transpose(glm::mat3(mv)));
+		draw.itmv = glm::inverse(glm::transpose(glm::mat3(local_to_world)));
+	}
+
+	//sort so that each program, material, and vao is bound as few times as possible:
+	// (variants map one-to-one to programs, so sorting by variant groups programs without looking them up)
+	// (NOTE: this means blended objects aren't drawn in any particular order)
+	std::sort(list->draws.begin(), list->draws.end(), [](DrawList::Draw const &a, DrawList::Draw const &b) {
+		if (a.variant != b.variant) return a.variant < b.variant;
+		if (a.program != b.program) return a.program < b.program;
+		if (a.material != b.material) return a.material < b.material;
+		return a.vao < b.vao;
+	});
+}
+
+void Scene::draw(Scene::DrawList const &list) {
+	GPUProfiler::Scope profile("Scene::draw");
+
+	//upload any changed materials before drawing with them:
+	Materials::update();
+
+	//program and uniform indices for the current run of draws:
+	ShaderVariants::Key current_variant = ShaderVariants::NoVariant;
+	GLuint current_program = -1U;
+	GLuint program = 0, program_mvp_mat4 = -1U, program_mv_mat4x3 = -1U, program_itmv_mat3 = -1U;
+	bool skip = false; //the current variant is still compiling
+
+	Materials::ID bound_material = -1U;
+	for (DrawList::Draw const &draw : list.draws) {
+		//look up the program (a shader variant, if the object has one) when it changes:
+		if (draw.variant != current_variant || (draw.variant == ShaderVariants::NoVariant && draw.program != current_program)) {
+			current_variant = draw.variant;
+			current_program = draw.program;
+			skip = false;
+			if (draw.variant != ShaderVariants::NoVariant) {
+				//(variants that weren't loaded up front are compiled in the background; their objects appear once linked)
+				ShaderVariants::Program const *variant = ShaderVariants::try_get(draw.variant);
+				if (!variant) {
+					skip = true;
+					continue;
+				}
+				program = variant->program;
+				program_mvp_mat4 = variant->object_to_clip_mat4;
+				program_mv_mat4x3 = variant->object_to_light_mat4x3;
+				program_itmv_mat3 = variant->normal_to_light_mat3;
+			} else {
+				program = draw.program;
+				program_mvp_mat4 = draw.program_mvp_mat4;
+				program_mv_mat4x3 = draw.program_mv_mat4x3;
+				program_itmv_mat3 = draw.program_itmv_mat3;
+			}
+		}
+		if (skip) continue;
 
 		//set up program uniforms:
-		glUseProgram(object->program);
-		if (object->program_mvp_mat4 != -1U) {
-			glUniformMatrix4fv(object->program_mvp_mat4, 1, GL_FALSE, glm::value_ptr(mvp));
+		GLState::use_program(program);
+		if (program_mvp_mat4 != -1U) {
+			GLState::uniform(program_mvp_mat4, draw.mvp);
 		}
-		if (object->program_mv_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(object->program_mv_mat4x3, 1, GL_FALSE, glm::value_ptr(mv));
+		if (program_mv_mat4x3 != -1U) {
+			GLState::uniform(program_mv_mat4x3, draw.mv);
 		}
-		if (object->program_itmv_mat3 != -1U) {
-			glUniformMatrix3fv(object->program_itmv_mat3, 1, GL_FALSE, glm::value_ptr(itmv));
+		if (program_itmv_mat3 != -1U) {
+			GLState::uniform(program_itmv_mat3, draw.itmv);
 		}
 
-		if (object->set_uniforms) object->set_uniforms();
+		//set material parameters (only when they change, thanks to sorting):
+		if (draw.material != bound_material) {
+			Materials::bind(draw.material);
+			bound_material = draw.material;
+		}
 
-		glBindVertexArray(object->vao);
+		GLState::bind_vertex_array(draw.vao);
 
 		//draw the object:
-		glDrawArrays(GL_TRIANGLES, object->start, object->count);
+		glDrawArrays(GL_TRIANGLES, draw.start, draw.count);
 	}
 }
 
+void Scene::draw(Scene::Camera const *camera) {
+	static DrawList list; //(kept between frames to avoid reallocating)
+	extract(camera, &list);
+	draw(list);
+}
 
-std::unordered_map<std::string, Scene::Transform*> Scene::load(std::string const &filename) {
+Scene::Prefab::Prefab(std::string const &filename) {
+	if (!(filename.size() >= 6 && filename.substr(filename.size() - 6) == ".scene")) {
+		throw std::runtime_error("Unknown file type '" + filename + "'");
+	}
 
-	// Open the file
 	std::ifstream file(filename, std::ios::binary);
 
+	std::vector< char > strings;
+	read_chunk(file, "str0", &strings);
+
 	struct BlenderTransform {
-		int parent;
+		int parent; //index into transforms (always less than own index), or -1
 		uint32_t name_start;
 		uint32_t name_end;
 		glm::vec3 position;
@@ -223,18 +495,17 @@ std::unordered_map<std::string, Scene::Transform*> Scene::load(std::string const
 		glm::vec3 scale;
 	};
 	static_assert(sizeof(BlenderTransform) == 4+4+4+(4*3)+(4*4)+(4*3), "Simple transform should be packed");
-	
-	// All the transforms exported by the scene
-	std::vector< BlenderTransform > transforms;
+	std::vector< BlenderTransform > xfhs;
+	read_chunk(file, "xfh0", &xfhs);
 
 	struct BlenderMesh {
 		int hierarchy_ref;
 		uint32_t name_start;
 		uint32_t name_end;
 	};
-
 	static_assert(sizeof(BlenderMesh) == 4+4+4, "Simple mesh should be packed");
-	std::vector< BlenderMesh > meshes;
+	std::vector< BlenderMesh > blender_meshes;
+	read_chunk(file, "msh0", &blender_meshes);
 
 	struct BlenderCamera {
 		int hierarchy_ref;
@@ -243,9 +514,9 @@ std::unordered_map<std::string, Scene::Transform*> Scene::load(std::string const
 		float clip_start;
 		float clip_end;
 	};
-
 	static_assert(sizeof(BlenderCamera) == 4+(1*4)+4+4+4, "Simple camera should be packed");
-	std::vector< BlenderCamera > cameras;
+	std::vector< BlenderCamera > cams;
+	read_chunk(file, "cam0", &cams);
 
 	struct BlenderLamp {
 		int hierarchy_ref;
@@ -258,199 +529,426 @@ std::unordered_map<std::string, Scene::Transform*> Scene::load(std::string const
 		float fov;
 	};
 	static_assert(sizeof(BlenderLamp) == 4+1+1+1+1+4+4+4, "Lamp should be packed");
-	std::vector<BlenderLamp> lamps;
+	std::vector< BlenderLamp > lmps;
+	read_chunk(file, "lmp0", &lmps);
 
-	std::vector< char > strings;
-	read_chunk(file, "str0", &strings);
-
-	auto print_blender_transform = [](BlenderTransform trans) {
-		printf("POS: x: %f, y: %f, z: %f\nROT: x: %f, y: %f, z: %f, w: %f\nSCL: x: %f, y: %f, z: %f\n",
-		trans.position.x, trans.position.y, trans.position.z,
-		trans.rotation.x, trans.rotation.y, trans.rotation.z, trans.rotation.w, 
-		trans.scale.x, trans.scale.y, trans.scale.z
-		);
+	auto check_name = [&](uint32_t name_start, uint32_t name_end) {
+		if (!(name_start <= name_end && name_end <= strings.size())) {
+			throw std::runtime_error("Scene file '" + filename + "' contains a name outside of its strings chunk.");
+		}
 	};
-
-	auto get_blendermesh_name = [&strings](BlenderMesh mesh) {
-		std::string name(&strings[0] + mesh.name_start, &strings[0] + mesh.name_end);
-		return name;
+	auto check_ref = [&](int ref) {
+		if (ref < 0 || uint32_t(ref) >= xfhs.size()) {
+			throw std::runtime_error("Scene file '" + filename + "' refers to a transform that doesn't exist.");
+		}
 	};
 
-	if (filename.size() >= 6 && filename.substr(filename.size() - 6) == ".scene") {
+	//the exporter writes parents before their children, so parents are checked (and stored) by index:
+	transforms.reserve(xfhs.size());
+	for (uint32_t i = 0; i < xfhs.size(); ++i) {
+		BlenderTransform const &xfh = xfhs[i];
+		check_name(xfh.name_start, xfh.name_end);
+		if (xfh.parent != -1 && !(xfh.parent >= 0 && uint32_t(xfh.parent) < i)) {
+			throw std::runtime_error("Scene file '" + filename + "' has a transform whose parent doesn't come before it.");
+		}
+		transforms.emplace_back();
+		Transform &transform = transforms.back();
+		transform.parent = (xfh.parent == -1 ? -1U : uint32_t(xfh.parent));
+		transform.name = Names::intern(strings.data() + xfh.name_start, strings.data() + xfh.name_end);
+		transform.position = xfh.position;
+		transform.rotation = xfh.rotation;
+		transform.scale = xfh.scale;
+	}
 
-		read_chunk(file, "xfh0", &transforms);
-		read_chunk(file, "msh0", &meshes);
-		read_chunk(file, "cam0", &cameras);
-		read_chunk(file, "lmp0", &lamps);
+	meshes.reserve(blender_meshes.size());
+	for (BlenderMesh const &mesh : blender_meshes) {
+		check_ref(mesh.hierarchy_ref);
+		check_name(mesh.name_start, mesh.name_end);
+		meshes.emplace_back();
+		meshes.back().transform = uint32_t(mesh.hierarchy_ref);
+		meshes.back().name = Names::intern(strings.data() + mesh.name_start, strings.data() + mesh.name_end);
+	}
 
-		/* Print out the information about the imported structs
-		printf("All Blender Transforms:\n");
-		for (uint32_t i = 0; i < transforms.size(); i++) {
-			printf("Transform: %d\n", i);
-			print_blender_transform(transforms[i]);
-		}
+	cameras.reserve(cams.size());
+	for (BlenderCamera const &cam : cams) {
+		check_ref(cam.hierarchy_ref);
+		cameras.emplace_back();
+		cameras.back().transform = uint32_t(cam.hierarchy_ref);
+	}
 
-		printf("All Meshes:\n");
-		for (uint32_t i = 0; i < meshes.size(); i++) {
-			printf("Name: %s - Ref: %d\n", get_blendermesh_name(meshes[i]).c_str(), meshes[i].hierarchy_ref);
+	lamps.reserve(lmps.size());
+	for (BlenderLamp const &lmp : lmps) {
+		check_ref(lmp.hierarchy_ref);
+		lamps.emplace_back();
+		Lamp &lamp = lamps.back();
+		lamp.transform = uint32_t(lmp.hierarchy_ref);
+		switch (lmp.type) {
+			case 'p': lamp.type = Scene::Lamp::Point; break;
+			case 'h': lamp.type = Scene::Lamp::Hemisphere; break;
+			case 's': lamp.type = Scene::Lamp::Spot; break;
+			case 'd': lamp.type = Scene::Lamp::Directional; break;
+			default:
+				std::cerr << "WARNING: Lamp type '" << lmp.type << "' in filename '" << filename << "' is unknown; treating it as a point lamp." << std::endl;
+				lamp.type = Scene::Lamp::Point;
 		}
-
-		printf("Cameras: \n");
-		for (uint32_t i = 0; i < cameras.size(); i++) {
-			printf("Type: %.*s - Ref: %d\n", 4, cameras[i].type, cameras[i].hierarchy_ref);
+		//(color is stored as unsigned bytes)
+		lamp.color = glm::vec3(uint8_t(lmp.r), uint8_t(lmp.g), uint8_t(lmp.b)) / 255.0f;
+		lamp.energy = lmp.energy;
+		lamp.distance = lmp.distance;
+		//(spot fov is stored in degrees)
+		if (lamp.type == Scene::Lamp::Spot) {
+			lamp.fov = glm::radians(lmp.fov);
 		}
+	}
+}
 
-		printf("Lamps: \n");
-		for (uint32_t i = 0; i < lamps.size(); i++) {
-			printf("Type: %c - Ref: %d\n", lamps[i].type, lamps[i].hierarchy_ref);
-		}
-		*/
+void Scene::instantiate(Scene::Prefab const &prefab, Scene::Transform *parent, std::vector< Scene::Transform * > *created_) {
+	std::vector< Transform * > local_created;
+	std::vector< Transform * > &created = (created_ ? *created_ : local_created);
+	created.clear();
+	created.reserve(prefab.transforms.size());
+
+	//(so the creates below don't allocate one slab at a time)
+	transforms.reserve(uint32_t(prefab.transforms.size()));
+	cameras.reserve(uint32_t(prefab.cameras.size()));
+	lamps.reserve(uint32_t(prefab.lamps.size()));
+	//(the name index is grown geometrically, since reserving exactly what's needed would rehash it on every instantiate)
+	size_t names = transforms_by_name.size() + prefab.transforms.size();
+	if (names > transforms_by_name.bucket_count() * transforms_by_name.max_load_factor()) {
+		transforms_by_name.reserve(2 * names);
+	}
 
-	} else {
-		throw std::runtime_error("Unknown file type '" + filename + "'");
+	//the new transforms are linked in directly (rather than with new_transform, set_name, and set_parent),
+	// since they start out unnamed and unparented, and each parent comes before its children:
+	assert((parent == nullptr || parent->scene == this) && "Can't instantiate under another scene's transform.");
+	for (Prefab::Transform const &pt : prefab.transforms) {
+		Transform *transform = transforms.create(this);
+		transform->position = pt.position;
+		transform->rotation = pt.rotation;
+		transform->scale = pt.scale;
+		if (pt.name != Names::None) {
+			transform->name = pt.name;
+			transforms_by_name.emplace(pt.name, handle(transform));
+		}
+		Transform *new_parent = (pt.parent == -1U ? parent : created[pt.parent]);
+		if (new_parent) {
+			//(added as the last child, as set_parent does)
+			transform->parent = new_parent;
+			transform->prev_sibling = new_parent->last_child;
+			if (transform->prev_sibling) transform->prev_sibling->next_sibling = transform;
+			new_parent->last_child = transform;
+		}
+		created.emplace_back(transform);
 	}
+	hierarchy_version += 1;
 
-	
+	for (Prefab::Camera const &pc : prefab.cameras) {
+		new_camera(created[pc.transform]);
+	}
 
-	// Lambda to check if the begin and end name indices are valid
-	auto valid_range = [&strings](uint32_t name_begin, uint32_t name_end) {
-		return name_begin <= name_end && name_end <= strings.size();
-	};
-	
+	for (Prefab::Lamp const &pl : prefab.lamps) {
+		Lamp *lamp = new_lamp(created[pl.transform]);
+		lamp->type = pl.type;
+		lamp->color = pl.color;
+		lamp->energy = pl.energy;
+		lamp->distance = pl.distance;
+		lamp->fov = pl.fov;
+	}
+}
 
-	std::unordered_map<std::string, Transform*> name_to_trans;
-	std::unordered_map<int, std::string> ref_to_name;
-	
+void Scene::load(std::string const &filename) {
+	instantiate(Prefab(filename));
+}
 
-	{ // Create the transform heirarchy
-		Transform *transform;
+Scene::~Scene() {
+	//everything is going away, so there's no need for transforms to unlink from each other as they are destroyed:
+	for (Transform &transform : transforms) {
+		transform.parent = transform.last_child = transform.prev_sibling = transform.next_sibling = nullptr;
+	}
+	//(the pools release their slabs -- objects, cameras, and lamps only hold pointers to transforms)
+}
 
-		// Fill the two maps created above
-		for (uint32_t i = 0; i < meshes.size(); i++) {
-			if (valid_range(meshes[i].name_start, meshes[i].name_end)) {
-				BlenderTransform btrans = transforms[meshes[i].hierarchy_ref];\
+void Scene::compact() {
+	//transforms, in the order update_transforms() computes them (parents before children):
+	update_transforms();
+	std::vector< Transform * > transform_order = transform_arrays.transforms;
+	transforms.compact(transform_order, [this](std::vector< std::pair< Transform *, Transform * > > const &moves){
+		std::unordered_map< Transform const *, Transform * > moved;
+		moved.reserve(moves.size());
+		for (auto const &move : moves) {
+			moved.emplace(move.first, move.second);
+		}
+		auto fix = [&moved](Transform *&t) {
+			if (t) t = moved.at(t);
+		};
+		for (auto const &move : moves) {
+			Transform *t = move.second;
+			fix(t->parent);
+			fix(t->last_child);
+			fix(t->prev_sibling);
+			fix(t->next_sibling);
+			//(so the moved-from transform's destructor doesn't unlink anything)
+			move.first->parent = move.first->last_child = move.first->prev_sibling = move.first->next_sibling = nullptr;
+		}
+		for (Object &object : objects) fix(object.transform);
+		for (Camera &camera : cameras) fix(camera.transform);
+		for (Lamp &lamp : lamps) fix(lamp.transform);
+	});
+	//(indices are unchanged, but transform_arrays.transforms points to the old transforms)
+	transform_arrays.hierarchy_version = -1U;
+
+	//objects, in roughly the order draw() sorts them:
+	std::vector< Object * > object_order;
+	object_order.reserve(objects.size());
+	for (Object &object : objects) {
+		object_order.emplace_back(&object);
+	}
+	std::stable_sort(object_order.begin(), object_order.end(), [](Object const *a, Object const *b) {
+		if (a->variant != b->variant) return a->variant < b->variant;
+		if (a->program != b->program) return a->program < b->program;
+		if (a->material != b->material) return a->material < b->material;
+		return a->vao < b->vao;
+	});
+	objects.compact(object_order, [](std::vector< std::pair< Object *, Object * > > const &){ });
+
+	//cameras and lamps, in their current order:
+	std::vector< Camera * > camera_order;
+	for (Camera &camera : cameras) {
+		camera_order.emplace_back(&camera);
+	}
+	cameras.compact(camera_order, [](std::vector< std::pair< Camera *, Camera * > > const &){ });
 
-				std::string name = get_blendermesh_name(meshes[i]);
-				// Create new transform
-				transform = new_transform();
+	std::vector< Lamp * > lamp_order;
+	for (Lamp &lamp : lamps) {
+		lamp_order.emplace_back(&lamp);
+	}
+	lamps.compact(lamp_order, [](std::vector< std::pair< Lamp *, Lamp * > > const &){ });
+}
 
-				transform->name = name;
-				transform->position = btrans.position;
-				transform->rotation = btrans.rotation;
-				transform->scale = btrans.scale;
+//records written by Scene::save, one per scene thing (in pool order):
+// (value-initialized before filling in, so padding is zeroed and equal states save equal blobs)
+namespace {
+	struct TransformRecord {
+		Scene::TransformHandle handle;
+		Scene::TransformHandle parent; //(default handle if no parent)
+		Names::ID name;
+		glm::vec3 position;
+		glm::quat rotation;
+		glm::vec3 scale;
+	};
+	struct ObjectRecord {
+		Scene::ObjectHandle handle;
+		Scene::TransformHandle transform;
+		ShaderVariants::Key variant;
+		GLuint program;
+		GLuint program_mvp_mat4, program_mv_mat4x3, program_itmv_mat3;
+		Materials::ID material;
+		GLuint vao, start, count;
+	};
+	struct CameraRecord {
+		Scene::CameraHandle handle;
+		Scene::TransformHandle transform;
+		float fovy, aspect, near;
+	};
+	struct LampRecord {
+		Scene::LampHandle handle;
+		Scene::TransformHandle transform;
+		Scene::Lamp::Type type;
+		glm::vec3 color;
+		float energy, distance, fov;
+	};
+}
 
-				bool inserted = false;
-				inserted = name_to_trans.insert(std::make_pair(name, transform)).second;
-				if (!inserted) {
-					std::cerr << "WARNING: mesh name '" + name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
-				}
+void Scene::save(StateBlob *blob) const {
+	assert(blob);
+	uint32_t counts[4] = {transforms.size(), objects.size(), cameras.size(), lamps.size()};
+	blob->write(counts, 4);
+
+	for (Transform const &transform : transforms) {
+		TransformRecord record = TransformRecord();
+		record.handle = handle(&transform);
+		record.parent = (transform.parent ? handle(transform.parent) : TransformHandle());
+		record.name = transform.name;
+		record.position = transform.position;
+		record.rotation = transform.rotation;
+		record.scale = transform.scale;
+		blob->write(record);
+	}
+	for (Object const &object : objects) {
+		ObjectRecord record = ObjectRecord();
+		record.handle = handle(&object);
+		record.transform = handle(object.transform);
+		record.variant = object.variant;
+		record.program = object.program;
+		record.program_mvp_mat4 = object.program_mvp_mat4;
+		record.program_mv_mat4x3 = object.program_mv_mat4x3;
+		record.program_itmv_mat3 = object.program_itmv_mat3;
+		record.material = object.material;
+		record.vao = object.vao;
+		record.start = object.start;
+		record.count = object.count;
+		blob->write(record);
+	}
+	for (Camera const &camera : cameras) {
+		CameraRecord record = CameraRecord();
+		record.handle = handle(&camera);
+		record.transform = handle(camera.transform);
+		record.fovy = camera.fovy;
+		record.aspect = camera.aspect;
+		record.near = camera.near;
+		blob->write(record);
+	}
+	for (Lamp const &lamp : lamps) {
+		LampRecord record = LampRecord();
+		record.handle = handle(&lamp);
+		record.transform = handle(lamp.transform);
+		record.type = lamp.type;
+		record.color = lamp.color;
+		record.energy = lamp.energy;
+		record.distance = lamp.distance;
+		record.fov = lamp.fov;
+		blob->write(record);
+	}
+}
 
-				inserted = ref_to_name.insert(std::make_pair(meshes[i].hierarchy_ref, name)).second;
-				if (!inserted) {
-					std::cerr << "WARNING: mesh hierarchy reference number \'" << (int)(meshes[i].hierarchy_ref)  << "\' in filename \'" << filename << "\' collides with existing reference." << std::endl;
-				}
-			}
-		}
+void Scene::restore(StateBlob::Reader &reader) {
+	size_t start = reader.offset;
 
-		// Do the same for the cameras
-		for (uint32_t i = 0; i < cameras.size(); i++) {
-			std::string name("Camera-" + i);
-			BlenderTransform btrans = transforms[cameras[i].hierarchy_ref];
-			// Create a new scene transform
-			transform = new_transform();
-			transform->name = name;
-			transform->position = btrans.position;
-			transform->rotation = btrans.rotation;
-			transform->scale = btrans.scale;
-			// Add the camera to the scene since we dont attach objects
-			new_camera(transform);
-
-
-			bool inserted = false;
-			inserted = name_to_trans.insert(std::make_pair(name, transform)).second;
-			if (!inserted) {
-				std::cerr << "WARNING: Camera name '" + name + "' collides with existing camera." << std::endl;
-			}
+	//check that the snapshot is of these very things (before changing any of them):
+	uint32_t counts[4];
+	reader.read(counts, 4);
+	if (counts[0] != transforms.size() || counts[1] != objects.size() || counts[2] != cameras.size() || counts[3] != lamps.size()) {
+		throw std::runtime_error("Scene snapshot doesn't match the scene (things were created or deleted since it was saved).");
+	}
+	auto mismatch = [](){
+		throw std::runtime_error("Scene snapshot doesn't match the scene (things were replaced since it was saved).");
+	};
+	bool reparent = false; //(does any transform have a different parent than when saved?)
+	for (Transform const &transform : transforms) {
+		TransformRecord record;
+		reader.read(&record);
+		if (record.handle != handle(&transform)) mismatch();
+		if (record.parent != TransformHandle() && !get(record.parent)) mismatch();
+		if (get(record.parent) != transform.parent) reparent = true;
+	}
+	for (Object const &object : objects) {
+		ObjectRecord record;
+		reader.read(&record);
+		if (record.handle != handle(&object) || record.transform != handle(object.transform)) mismatch();
+	}
+	for (Camera const &camera : cameras) {
+		CameraRecord record;
+		reader.read(&record);
+		if (record.handle != handle(&camera) || record.transform != handle(camera.transform)) mismatch();
+	}
+	for (Lamp const &lamp : lamps) {
+		LampRecord record;
+		reader.read(&record);
+		if (record.handle != handle(&lamp) || record.transform != handle(lamp.transform)) mismatch();
+	}
 
-			inserted = ref_to_name.insert(std::make_pair(cameras[i].hierarchy_ref, name)).second;
-			if (!inserted) {
-				std::cerr << "WARNING: Camera hierarchy reference number \'" << (int)(meshes[i].hierarchy_ref)  << "\' in filename \'" << filename << "\' collides with existing reference." << std::endl;
-			}
+	//restore transforms (re-parenting in two steps, so the hierarchy never has a cycle in it):
+	if (reparent) {
+		reader.offset = start + sizeof(counts);
+		for (Transform &transform : transforms) {
+			TransformRecord record;
+			reader.read(&record);
+			if (get(record.parent) != transform.parent) transform.set_parent(nullptr);
 		}
-
-		// Do the same for lamps
-		for (uint32_t i = 0; i < lamps.size(); i++) {
-			std::string name("Lamp-" + i);
-			BlenderTransform btrans = transforms[lamps[i].hierarchy_ref];
-			// Create a new scene transform
-			transform = new_transform();
-			transform->name = name;
-			transform->position = btrans.position;
-			transform->rotation = btrans.rotation;
-			transform->scale = btrans.scale;
-
-
-			bool inserted = false;
-			inserted = name_to_trans.insert(std::make_pair(name, transform)).second;
-			if (!inserted) {
-				std::cerr << "WARNING: Lamp name '" + name + "' collides with existing lamp." << std::endl;
-			}
-
-			inserted = ref_to_name.insert(std::make_pair(lamps[i].hierarchy_ref, name)).second;
-			if (!inserted) {
-				std::cerr << "WARNING: Lamp hierarchy reference number \'" << (int)(lamps[i].hierarchy_ref)  << "\' in filename \'" << filename << "\' collides with existing reference." << std::endl;
-			}
+		reader.offset = start + sizeof(counts);
+		for (Transform &transform : transforms) {
+			TransformRecord record;
+			reader.read(&record);
+			if (get(record.parent) != transform.parent) transform.set_parent(get(record.parent));
 		}
+	}
+	reader.offset = start + sizeof(counts);
+	for (Transform &transform : transforms) {
+		TransformRecord record;
+		reader.read(&record);
+		set_name(&transform, record.name);
+		transform.position = record.position;
+		transform.rotation = record.rotation;
+		transform.scale = record.scale;
+	}
+	for (Object &object : objects) {
+		ObjectRecord record;
+		reader.read(&record);
+		object.variant = record.variant;
+		object.program = record.program;
+		object.program_mvp_mat4 = record.program_mvp_mat4;
+		object.program_mv_mat4x3 = record.program_mv_mat4x3;
+		object.program_itmv_mat3 = record.program_itmv_mat3;
+		object.material = record.material;
+		object.vao = record.vao;
+		object.start = record.start;
+		object.count = record.count;
+	}
+	for (Camera &camera : cameras) {
+		CameraRecord record;
+		reader.read(&record);
+		camera.fovy = record.fovy;
+		camera.aspect = record.aspect;
+		camera.near = record.near;
+	}
+	for (Lamp &lamp : lamps) {
+		LampRecord record;
+		reader.read(&record);
+		lamp.type = record.type;
+		lamp.color = record.color;
+		lamp.energy = record.energy;
+		lamp.distance = record.distance;
+		lamp.fov = record.fov;
+	}
+}
 
+void Scene::set_name(Scene::Transform *transform, std::string const &name) {
+	set_name(transform, Names::intern(name));
+}
 
-		// Loop through the transforms and fix parents for meshes
-		for (uint32_t i = 0; i < transforms.size(); i++) {
-			// Find the pointer to the parent's transform
-			Transform *parent_trans = nullptr;
-			auto it = ref_to_name.find(transforms[i].parent);
-			if (it != ref_to_name.end()) {
-				std::string parent_name = it->second;
-				auto it2 = name_to_trans.find(parent_name);
-				if (it2 != name_to_trans.end()) {
-					parent_trans = it2->second;
-				}
-			}
-
-			// Get the real transform for this simple transform
-			Transform *my_trans = nullptr;
-			std::string name(&strings[0] + transforms[i].name_start, &strings[0] + transforms[i].name_end);
-			auto it3 = name_to_trans.find(name);
-			if (it3 !=  name_to_trans.end()) {
-				my_trans = it3->second;
-			}
-
-			// Set the parent to the transform
-			if (my_trans != nullptr && parent_trans != nullptr) {
-				my_trans->set_parent(parent_trans);
+void Scene::set_name(Scene::Transform *transform, Names::ID name) {
+	assert(transform && "Can't name a null transform.");
+	if (transform->name == name) return;
+	TransformHandle h = handle(transform);
+	if (transform->name != Names::None) {
+		auto range = transforms_by_name.equal_range(transform->name);
+		for (auto i = range.first; i != range.second; ++i) {
+			if (i->second == h) {
+				transforms_by_name.erase(i);
+				break;
 			}
 		}
 	}
-	
-	return name_to_trans;
+	transform->name = name;
+	if (name != Names::None) {
+		transforms_by_name.emplace(name, h);
+	}
 }
 
-Scene::~Scene() {
-	while (first_camera) {
-		delete_camera(first_camera);
-	}
-	while (first_object) {
-		delete_object(first_object);
-	}
-	while (first_transform) {
-		delete_transform(first_transform);
-	}
+Scene::Transform *Scene::get_transform(std::string const &name) const {
+	//(names that were never interned can't belong to any transform)
+	Names::ID id = Names::find(name);
+	if (id == Names::None) return nullptr;
+	return get_transform(id);
 }
 
-Scene::Object *Scene::get_object(std::string const &name) {
-	for (Scene::Object *object = first_object; object != nullptr; object = object->alloc_next) {
-		if (object->transform->name == name) {
-			return object;
-		}
+Scene::Transform *Scene::get_transform(Names::ID name) const {
+	auto f = transforms_by_name.find(name);
+	if (f == transforms_by_name.end()) return nullptr;
+	return get(f->second);
+}
+
+Scene::Object *Scene::get_object(std::string const &name) const {
+	Names::ID id = Names::find(name);
+	if (id == Names::None) return nullptr;
+	return get_object(id);
+}
+
+Scene::Object *Scene::get_object(Names::ID name) const {
+	auto range = transforms_by_name.equal_range(name);
+	for (auto i = range.first; i != range.second; ++i) {
+		auto f = objects_by_transform.find(i->second.index);
+		if (f != objects_by_transform.end()) return get(f->second);
 	}
 	return nullptr;
 }
\ No newline at end of file
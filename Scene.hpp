@@ -1,21 +1,25 @@
 #pragma once
 
 #include "GL.hpp"
+#include "ShaderVariants.hpp"
+#include "Materials.hpp"
+#include "Names.hpp"
+#include "Pool.hpp"
+#include "StateBlob.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
 #include <vector>
 #include <list>
-#include <functional>
 #include <unordered_map>
 
 //"Scene" manages a hierarchy of transformations with, potentially, attached information.
 struct Scene {
 
 	struct Transform {
-		// Extra
-		std::string name = "";
+		//name (interned; set with Scene::set_name, which keeps the scene's name index up to date):
+		Names::ID name = Names::None;
 
 		//simple specification:
 		glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -38,12 +42,22 @@ struct Scene {
 		//computed from the above:
 		glm::mat4 make_local_to_parent() const;
 		glm::mat4 make_parent_to_local() const;
+		//world matrices, as of the scene's last update_transforms() (just looked up, so O(1)):
+		// (call scene->update_transforms() first if this transform or its ancestors changed since then)
 		glm::mat4 make_local_to_world() const;
 		glm::mat4 make_world_to_local() const;
 
+		//the scene this transform belongs to:
+		Scene *scene;
+		//position in Scene::transform_arrays (set by Scene::update_transforms):
+		uint32_t index = -1U;
+
 		//constructor/destructor:
-		Transform() = default;
+		Transform(Scene *scene_) : scene(scene_) {
+			assert(scene);
+		}
 		Transform(Transform &) = delete;
+		Transform(Transform &&) = default; //(only for Scene::compact, which fixes up the hierarchy pointers)
 		~Transform() {
 			while (last_child) {
 				last_child->set_parent(nullptr);
@@ -52,36 +66,31 @@ struct Scene {
 				set_parent(nullptr);
 			}
 		}
-
-		//used by Scene to manage allocation:
-		Transform **alloc_prev_next = nullptr;
-		Transform *alloc_next = nullptr;
 	};
 
 	//"Object"s contain information needed to render meshes:
 	struct Object {
-		Transform *transform; //objects must be attached to transforms.
+		Transform *transform; //objects must be attached to transforms (and stay attached: get_object indexes them by transform).
 		Object(Transform *transform_) : transform(transform_) {
 			assert(transform);
 		}
 
 		//program info:
+		//either a shader variant (whose program and uniform indices are used in place of those below)...
+		ShaderVariants::Key variant = ShaderVariants::NoVariant;
+		//...or a program of your own:
 		GLuint program = 0;
 		GLuint program_mvp_mat4 = -1U; //uniform index for object-to-clip matrix (mat4)
 		GLuint program_mv_mat4x3 = -1U; //uniform index for model-to-lighting-space matrix (mat4x3)
 		GLuint program_itmv_mat3 = -1U; //uniform index for normal-to-lighting-space matrix (mat3)
 
-		//material info:
-		std::function< void() > set_uniforms; //will be called before rendering object, use to set material parameters (e.g. glossiness)
+		//material info (parameters of the shader's 'Material' block, and texture; see Materials.hpp):
+		Materials::ID material = Materials::Default;
 
 		//attribute info:
 		GLuint vao = 0;
 		GLuint start = 0;
 		GLuint count = 0;
-
-		//used by Scene to manage allocation:
-		Object **alloc_prev_next = nullptr;
-		Object *alloc_next = nullptr;
 	};
 
 	//"Camera"s contain information needed to view a scene:
@@ -98,19 +107,86 @@ struct Scene {
 		float near = 0.01f; //near plane
 		//computed from the above:
 		glm::mat4 make_projection() const;
+	};
+
+	//"Lamp"s contain information needed to light a scene:
+	struct Lamp {
+		Transform *transform; //lamps must be attached to transforms.
+		Lamp(Transform *transform_) : transform(transform_) {
+			assert(transform);
+		}
+		//NOTE: spot and directional lamps shine along their -z axis
 
-		//used by Scene to manage allocation:
-		Camera **alloc_prev_next = nullptr;
-		Camera *alloc_next = nullptr;
+		//lamp types (values match the .scene format):
+		enum Type : char {
+			Point = 'p',
+			Hemisphere = 'h',
+			Spot = 's',
+			Directional = 'd',
+		};
+		Type type = Point;
+
+		//lamp parameters:
+		glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f);
+		float energy = 1.0f;
+		float distance = 25.0f; //point and spot lamps have no effect beyond this distance
+		float fov = glm::radians(45.0f); //spot cone angle (in radians)
+	};
+
+	//"Prefab"s hold the contents of a .scene file (exported by meshes/export-scene.py) as flat arrays,
+	// so that copies can be made with instantiate() without reading the file again.
+	//(Prefabs don't change once loaded; e.g., Load< Scene::Prefab > prefab(LoadTagInit, ...))
+	struct Prefab {
+		Prefab(std::string const &filename);
+
+		struct Transform {
+			uint32_t parent = -1U; //index into transforms (always less than own index), or -1U
+			Names::ID name = Names::None;
+			glm::vec3 position = glm::vec3(0.0f);
+			glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+			glm::vec3 scale = glm::vec3(1.0f);
+		};
+		std::vector< Transform > transforms; //parents before children
+
+		//meshes aren't made into objects by instantiate() (the caller knows how to draw them),
+		// but are listed so the caller can attach objects to them:
+		struct Mesh {
+			uint32_t transform; //index into transforms
+			Names::ID name; //mesh name (as in a MeshBuffer)
+		};
+		std::vector< Mesh > meshes;
+
+		struct Camera {
+			uint32_t transform;
+		};
+		std::vector< Camera > cameras;
+
+		struct Lamp {
+			uint32_t transform;
+			Scene::Lamp::Type type = Scene::Lamp::Point;
+			glm::vec3 color = glm::vec3(1.0f);
+			float energy = 1.0f;
+			float distance = 25.0f;
+			float fov = glm::radians(45.0f);
+		};
+		std::vector< Lamp > lamps;
 	};
 
 	//------ functions to create / destroy scene things -----
 	//NOTE: all scene objects are automatically freed when scene is deallocated
-	std::unordered_map<std::string, Scene::Transform*> load(std::string const &filename);
+
+	//Copy a prefab into the scene -- its transforms (with the prefab's roots parented to 'parent', if given),
+	// cameras, and lamps -- with storage for all of them (and their names) reserved up front, and the transform
+	// hierarchy linked directly from the prefab's parent indices (so it changes the hierarchy version just once).
+	//If 'created' is given, it is filled with the new transforms: (*created)[i] is the copy of prefab.transforms[i].
+	void instantiate(Prefab const &prefab, Transform *parent = nullptr, std::vector< Transform * > *created = nullptr);
+
+	//Instantiate a .scene file (find its transforms with get_transform; attach objects to its meshes with new_object):
+	void load(std::string const &filename);
 
 	//Create a new transform:
 	Transform *new_transform();
-	//Delete an existing transform: (NOTE: it is an error to delete a transform with an attached Object or Camera)
+	//Delete an existing transform: (NOTE: it is an error to delete a transform with an attached Object, Camera, or Lamp)
 	void delete_transform(Transform *);
 
 	//Create a new object attached to a transform:
@@ -123,20 +199,124 @@ struct Scene {
 	//Delete a camera:
 	void delete_camera(Camera *);
 
-	Object *get_object(std::string const &name);
+	//Create a new lamp attached to a transform:
+	Lamp *new_lamp(Transform *transform);
+	//Delete a lamp:
+	void delete_lamp(Lamp *);
+
+	//Handles to scene things:
+	// unlike pointers, handles stay valid through compact(), and get() returns nullptr
+	// (instead of a dangling pointer) once the thing they refer to has been deleted.
+	typedef Pool< Transform >::Handle TransformHandle;
+	typedef Pool< Object >::Handle ObjectHandle;
+	typedef Pool< Camera >::Handle CameraHandle;
+	typedef Pool< Lamp >::Handle LampHandle;
+
+	TransformHandle handle(Transform const *transform) const { return transforms.handle(transform); }
+	ObjectHandle handle(Object const *object) const { return objects.handle(object); }
+	CameraHandle handle(Camera const *camera) const { return cameras.handle(camera); }
+	LampHandle handle(Lamp const *lamp) const { return lamps.handle(lamp); }
+
+	Transform *get(TransformHandle const &h) const { return transforms.get(h); }
+	Object *get(ObjectHandle const &h) const { return objects.get(h); }
+	Camera *get(CameraHandle const &h) const { return cameras.get(h); }
+	Lamp *get(LampHandle const &h) const { return lamps.get(h); }
+
+	//Move scene things into contiguous storage -- transforms in parent-before-child order, objects in
+	// draw order -- so traversal and drawing walk memory linearly; call after loading.
+	//NOTE: invalidates all pointers to transforms, objects, cameras, and lamps (handles stay valid).
+	void compact();
+
+	//Snapshot the scene's state -- transforms (name, position, rotation, scale, parent), objects (program,
+	// material, vertex range), cameras, and lamps -- and put it back in place later (e.g. to restart a level):
+	// restore() doesn't allocate (unless names or parents changed) or touch files, but the scene must still
+	// have the same transforms, objects, cameras, and lamps (by handle) as when it was saved; if it doesn't,
+	// restore() throws (before changing anything).
+	void save(StateBlob *blob) const;
+	void restore(StateBlob::Reader &reader);
+
+	//name index (maintained by set_name, delete_transform, new_object, and delete_object):
+	// (keyed by handle, so compact() doesn't disturb it)
+	std::unordered_multimap< Names::ID, TransformHandle > transforms_by_name;
+	std::unordered_multimap< uint32_t, ObjectHandle > objects_by_transform; //keyed by TransformHandle::index
+
+	//Name a transform:
+	void set_name(Transform *transform, std::string const &name);
+	void set_name(Transform *transform, Names::ID name);
 
-	//used to manage allocated objects:
-	Transform *first_transform = nullptr;
-	Object *first_object = nullptr;
-	Camera *first_camera = nullptr;
-	//(you shouldn't be manipulating these pointers directly
+	//Find a transform (or an object attached to a transform) by name, in O(1) using the name index:
+	// (if several match, returns any one of them)
+	Transform *get_transform(std::string const &name) const;
+	Transform *get_transform(Names::ID name) const;
+	Object *get_object(std::string const &name) const;
+	Object *get_object(Names::ID name) const;
+
+	//storage for scene things (iterate with, e.g., "for (Scene::Object &object : scene.objects)"):
+	// (use the functions above to create and delete them)
+	Pool< Transform > transforms;
+	Pool< Object > objects;
+	Pool< Camera > cameras;
+	Pool< Lamp > lamps;
 
 	//------ functions to traverse the scene ------
 
-	//Draw the scene from a given camera by computing appropriate matrices and sending all objects to OpenGL:
+	//"TransformArrays" holds every transform's local specification and world matrices as flat arrays,
+	// in parent-before-child order, so that all world matrices can be computed in one linear pass:
+	struct TransformArrays {
+		std::vector< Transform * > transforms; //transforms[i]->index == i
+		std::vector< uint32_t > parents; //index of parent (always less than own index), or -1U
+		//local specification, one array per component (padded with identity transforms to a multiple of four):
+		std::vector< float > position_x, position_y, position_z;
+		std::vector< float > rotation_x, rotation_y, rotation_z, rotation_w;
+		std::vector< float > scale_x, scale_y, scale_z;
+		//computed by update_transforms():
+		std::vector< glm::mat4 > local_to_parent, parent_to_local;
+		std::vector< glm::mat4 > local_to_world, world_to_local;
+		//(the order is rebuilt when transforms are created, deleted, or re-parented)
+		uint32_t hierarchy_version = -1U; //Scene::hierarchy_version when the order was built
+	};
+	TransformArrays transform_arrays;
+
+	//changes whenever a transform is created, deleted, or re-parented:
+	uint32_t hierarchy_version = 0;
+
+	//Copy every transform into transform_arrays (re-ordering if the hierarchy changed) and compute
+	// world matrices for all of them, using SSE where available; O(transforms) however deep the hierarchy is:
+	// (Transform::make_local_to_world and make_world_to_local return the results)
+	void update_transforms();
+
+	//"DrawList" is what drawing the scene sends to OpenGL: every object's program, material, and vertex
+	// range, with its matrices computed, in drawing order. Building one doesn't call OpenGL, so a
+	// DrawList can be built (e.g. on another thread) while a previous one is drawn:
+	struct DrawList {
+		struct Draw {
+			//program info, as in Object (a variant's program and uniform indices are looked up when drawn):
+			ShaderVariants::Key variant;
+			GLuint program;
+			GLuint program_mvp_mat4, program_mv_mat4x3, program_itmv_mat3;
+			Materials::ID material;
+			GLuint vao, start, count;
+			//uniform values:
+			glm::mat4 mvp;
+			glm::mat4x3 mv;
+			glm::mat3 itmv;
+		};
+		std::vector< Draw > draws;
+	};
+
+	//Compute matrices for every object as seen from a camera, and sort them into drawing order:
+	//"camera" must be non-null! (doesn't call OpenGL)
+	//(objects are drawn sorted by program, then material, then vao -- not in list order)
+	void extract(Camera const *camera, DrawList *list);
+	//Send a DrawList to OpenGL:
+	static void draw(DrawList const &list);
+
+	//Draw the scene from a given camera (extract, then draw):
 	//"camera" must be non-null!
 	void draw(Camera const *camera);
 
 
-	~Scene(); //destructor deallocates transforms, objects, cameras
+	Scene() = default;
+	Scene(Scene const &) = delete;
+	~Scene(); //destructor deallocates transforms, objects, cameras, lamps (all at once)
 };
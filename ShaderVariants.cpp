@@ -0,0 +1,222 @@
+#include "ShaderVariants.hpp"
+
+#include "compile_program.hpp"
+#include "LightClusters.hpp"
+#include "GLState.hpp"
+#include "Load.hpp"
+
+#include <array>
+#include <string>
+#include <cassert>
+
+namespace ShaderVariants {
+
+namespace {
+//local data:
+
+std::array< Program, KeyCount > programs;
+std::array< bool, KeyCount > submitted; //(zero-initialized, being static)
+
+//both shader stages are written once, with features in #ifdef blocks:
+//parameters from the bound material (matches struct Material in Materials.hpp):
+#define MATERIAL_BLOCK \
+	"layout(std140) uniform Material {\n" \
+	"	vec4 tint;\n" \
+	"	vec2 uv_offset;\n" \
+	"	vec2 uv_scale;\n" \
+	"};\n"
+
+char const *vertex_source =
+	MATERIAL_BLOCK
+	"uniform mat4 object_to_clip;\n"
+	"uniform mat4x3 object_to_light;\n"
+	"uniform mat3 normal_to_light;\n"
+	"layout(location=0) in vec4 Position;\n"
+	"layout(location=1) in vec3 Normal;\n"
+	"layout(location=2) in vec4 Color;\n"
+	"out vec3 position;\n"
+	"out vec3 normal;\n"
+	"out vec4 color;\n"
+	"#ifdef TEXTURED\n"
+	"layout(location=3) in vec2 TexCoord;\n"
+	"out vec2 texCoord;\n"
+	"#endif\n"
+	"#ifdef CLUSTERED\n"
+	"out vec4 clip_position;\n"
+	"#endif\n"
+	"void main() {\n"
+	"	gl_Position = object_to_clip * Position;\n"
+	"	position = object_to_light * Position;\n"
+	"	normal = normal_to_light * Normal;\n"
+	"	color = Color;\n"
+	"#ifdef TEXTURED\n"
+	"	texCoord = uv_offset + TexCoord * uv_scale;\n"
+	"#endif\n"
+	"#ifdef CLUSTERED\n"
+	"	clip_position = gl_Position;\n"
+	"#endif\n"
+	"}\n"
+;
+
+char const *fragment_source =
+	MATERIAL_BLOCK
+	"uniform vec3 sun_direction;\n"
+	"uniform vec3 sun_color;\n"
+	"uniform vec3 sky_direction;\n"
+	"uniform vec3 sky_color;\n"
+	"in vec3 position;\n"
+	"in vec3 normal;\n"
+	"in vec4 color;\n"
+	"out vec4 fragColor;\n"
+	"#ifdef TEXTURED\n"
+	"uniform sampler2D tex;\n"
+	"in vec2 texCoord;\n"
+	"#endif\n"
+	"#ifdef CLUSTERED\n"
+	"uniform vec4 cluster_depth;\n" //(first slice depth, far depth, slice scale, slice bias)
+	"uniform samplerBuffer lights;\n" //three texels per lamp: (position, range), (color, is spot), (direction, cos(fov/2))
+	"uniform usamplerBuffer clusters;\n" //(first index, count) per cluster
+	"uniform usamplerBuffer light_indices;\n"
+	"in vec4 clip_position;\n"
+	"#endif\n"
+	"void main() {\n"
+	"	vec3 total_light = vec3(0.0, 0.0, 0.0);\n"
+	"	vec3 n = normalize(normal);\n"
+	"	{ //sky (hemisphere) light:\n"
+	"		vec3 l = sky_direction;\n"
+	"		float nl = 0.5 + 0.5 * dot(n,l);\n"
+	"		total_light += nl * sky_color;\n"
+	"	}\n"
+	"	{ //sun (directional) light:\n"
+	"		vec3 l = sun_direction;\n"
+	"		float nl = max(0.0, dot(n,l));\n"
+	"		total_light += nl * sun_color;\n"
+	"	}\n"
+	"#ifdef CLUSTERED\n"
+	"	float depth = clip_position.w;\n" //(distance along the view direction)
+	"	if (depth < cluster_depth.y) { //point and spot lamps in this fragment's cluster:\n"
+	"		ivec3 cell;\n"
+	"		cell.xy = ivec2((clip_position.xy / clip_position.w * 0.5 + 0.5) * vec2(CLUSTER_GRID.xy));\n"
+	"		cell.xy = clamp(cell.xy, ivec2(0), CLUSTER_GRID.xy - 1);\n"
+	"		cell.z = (depth < cluster_depth.x ? 0 : min(CLUSTER_GRID.z - 1, 1 + int(log(depth) * cluster_depth.z + cluster_depth.w)));\n"
+	"		uvec2 range = texelFetch(clusters, cell.x + CLUSTER_GRID.x * (cell.y + CLUSTER_GRID.y * cell.z)).xy;\n"
+	"		for (uint i = range.x; i < range.x + range.y; ++i) {\n"
+	"			int light = 3 * int(texelFetch(light_indices, int(i)).x);\n"
+	"			vec4 position_range = texelFetch(lights, light);\n"
+	"			vec4 color_spot = texelFetch(lights, light + 1);\n"
+	"			vec4 direction_cutoff = texelFetch(lights, light + 2);\n"
+	"			vec3 to_light = position_range.xyz - position;\n"
+	"			float d2 = max(dot(to_light, to_light), 1e-8);\n"
+	"			vec3 l = to_light * inversesqrt(d2);\n"
+	//inverse-square falloff, windowed to reach zero at the lamp's range:
+	"			float window = clamp(1.0 - (d2 * d2) / pow(position_range.w, 4.0), 0.0, 1.0);\n"
+	"			float falloff = (window * window) / (d2 + 1.0);\n"
+	"			if (color_spot.w != 0.0) {\n"
+	"				falloff *= smoothstep(direction_cutoff.w, mix(direction_cutoff.w, 1.0, 0.2), dot(-l, direction_cutoff.xyz));\n"
+	"			}\n"
+	"			total_light += max(0.0, dot(n,l)) * falloff * color_spot.rgb;\n"
+	"		}\n"
+	"	}\n"
+	"#endif\n"
+	"#ifdef TEXTURED\n"
+	"	vec4 albedo = texture(tex, texCoord) * color;\n"
+	"#else\n"
+	"	vec4 albedo = color;\n"
+	"#endif\n"
+	"	albedo *= tint;\n"
+	"	fragColor = vec4(albedo.rgb * total_light, albedo.a);\n"
+	"}\n"
+;
+
+//"#version" line plus one #define per feature in the key:
+std::string make_header(Key key) {
+	std::string header = "#version 330\n";
+	if (key & Textured) {
+		header += "#define TEXTURED\n";
+	}
+	if (key & Clustered) {
+		header += "#define CLUSTERED\n";
+		header += "#define CLUSTER_GRID ivec3("
+			+ std::to_string(LightClusters::GridX) + ", "
+			+ std::to_string(LightClusters::GridY) + ", "
+			+ std::to_string(LightClusters::GridZ) + ")\n";
+	}
+	return header;
+}
+
+void finish(Key key) {
+	Program &p = programs[key];
+	assert(submitted[key]);
+	finish_program(p.program);
+
+	p.object_to_clip_mat4 = glGetUniformLocation(p.program, "object_to_clip");
+	p.object_to_light_mat4x3 = glGetUniformLocation(p.program, "object_to_light");
+	p.normal_to_light_mat3 = glGetUniformLocation(p.program, "normal_to_light");
+
+	p.sun_direction_vec3 = glGetUniformLocation(p.program, "sun_direction");
+	p.sun_color_vec3 = glGetUniformLocation(p.program, "sun_color");
+	p.sky_direction_vec3 = glGetUniformLocation(p.program, "sky_direction");
+	p.sky_color_vec3 = glGetUniformLocation(p.program, "sky_color");
+
+	p.cluster_depth_vec4 = glGetUniformLocation(p.program, "cluster_depth");
+
+	//buffer binding and texture units (which never change):
+	GLuint material_index = glGetUniformBlockIndex(p.program, "Material");
+	if (material_index != GL_INVALID_INDEX) {
+		glUniformBlockBinding(p.program, material_index, MaterialBinding);
+	}
+	GLState::use_program(p.program);
+	if (key & Textured) {
+		glUniform1i(glGetUniformLocation(p.program, "tex"), TextureUnit);
+	}
+	if (key & Clustered) {
+		glUniform1i(glGetUniformLocation(p.program, "lights"), LightsUnit);
+		glUniform1i(glGetUniformLocation(p.program, "clusters"), ClustersUnit);
+		glUniform1i(glGetUniformLocation(p.program, "light_indices"), LightIndicesUnit);
+	}
+
+	p.ready = true;
+}
+
+} //end anon namespace
+
+//------------------
+
+void submit(Key key) {
+	assert(key < KeyCount && "Unknown shader variant features.");
+	if (submitted[key]) return;
+	submitted[key] = true;
+
+	std::string header = make_header(key);
+	programs[key].key = key;
+	programs[key].program = submit_program(header + vertex_source, header + fragment_source);
+}
+
+Program const *load(Key key) {
+	submit(key);
+	add_load_function(LoadTagLink, [key](){
+		if (!programs[key].ready) finish(key);
+	});
+	return &programs[key];
+}
+
+Program const &get(Key key) {
+	assert(key < KeyCount && "Unknown shader variant features.");
+	if (!programs[key].ready) {
+		submit(key);
+		finish(key);
+	}
+	return programs[key];
+}
+
+Program const *try_get(Key key) {
+	assert(key < KeyCount && "Unknown shader variant features.");
+	if (!programs[key].ready) {
+		submit(key);
+		if (!program_ready(programs[key].program)) return nullptr;
+		finish(key);
+	}
+	return &programs[key];
+}
+
+} //namespace ShaderVariants
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <cstdint>
+
+//ShaderVariants builds the lit mesh program (vertex colors lit by a sun and a sky light) specialized
+// for a set of optional features. Each feature is a #define in the shader source, so a variant
+// contains only the code for the features it uses. Variants are compiled once and cached by key
+// (a bitmask of Feature values).
+//
+//Usage:
+// //at global scope (submits at LoadTagShaders, looks up locations at LoadTagLink):
+// Load< ShaderVariants::Program > lit_program(LoadTagShaders, [](){
+//     return ShaderVariants::load(ShaderVariants::Textured);
+// });
+// //...or, at any time after loading (compiles on first use, so prefer the above):
+// ShaderVariants::Program const &program = ShaderVariants::get(ShaderVariants::Textured);
+//
+//Scene::Object can reference a variant by key (see Scene.hpp), in which case Scene::draw uses it
+// (via try_get, so objects whose variant wasn't loaded up front are skipped until it has linked).
+//All variants use the same attribute locations, so a vertex array made for any variant works with all of them.
+
+namespace ShaderVariants {
+
+typedef uint32_t Key;
+
+enum Feature : Key {
+	//multiply a texture (from TextureUnit) into the color; needs TexCoord.
+	// TexCoord is transformed by the material's uv_offset and uv_scale (for textures in an atlas; see Materials.hpp):
+	Textured = 1,
+	//add point and spot lamps from LightClusters (see LightClusters.hpp), bound with LightClusters::bind():
+	Clustered = 2,
+};
+constexpr const uint32_t FeatureCount = 2;
+constexpr const Key KeyCount = (1 << FeatureCount);
+
+//Scene::Object::variant value for objects that set their own program:
+constexpr const Key NoVariant = -1U;
+
+//texture units used by features:
+constexpr const GLuint TextureUnit = 0; //Textured
+constexpr const GLuint LightsUnit = 1; //Clustered
+constexpr const GLuint ClustersUnit = 2; //Clustered
+constexpr const GLuint LightIndicesUnit = 3; //Clustered
+
+//uniform buffer binding of the 'Material' block (every variant has one; see Materials.hpp):
+constexpr const GLuint MaterialBinding = 0;
+
+//attribute locations (the same in every variant):
+constexpr const GLuint PositionLocation = 0;
+constexpr const GLuint NormalLocation = 1;
+constexpr const GLuint ColorLocation = 2;
+constexpr const GLuint TexCoordLocation = 3; //Textured
+
+struct Program {
+	Key key = 0;
+	//opengl program object:
+	GLuint program = 0;
+
+	//uniform locations (-1U if the variant doesn't use them):
+	GLuint object_to_clip_mat4 = -1U;
+	GLuint object_to_light_mat4x3 = -1U;
+	GLuint normal_to_light_mat3 = -1U;
+	GLuint sun_direction_vec3 = -1U;
+	GLuint sun_color_vec3 = -1U;
+	GLuint sky_direction_vec3 = -1U;
+	GLuint sky_color_vec3 = -1U;
+	//Clustered: (first slice depth, far depth, slice scale, slice bias), as set by LightClusters::bind():
+	GLuint cluster_depth_vec4 = -1U;
+
+	//locations have been looked up:
+	bool ready = false;
+};
+
+//start compiling a variant (without waiting for it):
+void submit(Key key);
+
+//submit a variant and look up its locations in LoadTagLink; for use in a Load< Program >:
+// (the returned pointer is to the cache entry, so it is valid immediately and forever)
+Program const *load(Key key);
+
+//get a variant, compiling it (and waiting for it) if needed:
+Program const &get(Key key);
+
+//get a variant if it is done compiling, or start compiling it and return nullptr; never waits for the driver.
+// (uses program_ready(), so without parallel shader compile support this finishes the variant, as get() does)
+Program const *try_get(Key key);
+
+} //namespace ShaderVariants
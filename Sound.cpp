@@ -100,6 +100,8 @@ void compute_pan_from_listener_and_position(
 
 //list of all currently playing samples:
 std::list< std::shared_ptr< PlayingSample > > playing_samples;
+//samples that finished while something still held them (so set_state can restart them without allocating):
+std::list< std::shared_ptr< PlayingSample > > finished_samples;
 
 void mix_audio(void *, Uint8 *stream, int len) {
 	assert(stream); //should always have some audio buffer
@@ -132,6 +134,9 @@ void mix_audio(void *, Uint8 *stream, int len) {
 	glm::vec3 end_right = listener.right.value;
 	float end_volume = volume.value;
 
+	//forget finished samples that nothing holds any more:
+	finished_samples.remove_if([](std::shared_ptr< PlayingSample > const &s){ return s.use_count() == 1; });
+
 	//now add audio for each playing sample:
 	for (auto si = playing_samples.begin(); si != playing_samples.end(); /* later */) {
 		PlayingSample &source = **si; //iterator over shared pointers
@@ -179,7 +184,12 @@ void mix_audio(void *, Uint8 *stream, int len) {
 		 ) {
 			auto old = si;
 			++si;
-			playing_samples.erase(old);
+			if (old->use_count() > 1) {
+				(*old)->finished = true;
+				finished_samples.splice(finished_samples.end(), playing_samples, old);
+			} else {
+				playing_samples.erase(old);
+			}
 		} else {
 			++si;
 		}
@@ -247,6 +257,15 @@ std::shared_ptr< PlayingSample > Sample::play(glm::vec3 const &position, float v
 	return playing_samples.back();
 }
 
+std::shared_ptr< PlayingSample > Sample::play(PlayingSampleState const &state) const {
+	if (!state.playing || data.empty()) return nullptr;
+	lock();
+	playing_samples.emplace_back(std::make_shared< PlayingSample >(this, state.position, state.volume, state.loop));
+	playing_samples.back()->i = std::min< uint32_t >(state.i, uint32_t(data.size()) - 1);
+	unlock();
+	return playing_samples.back();
+}
+
 
 //------------------
 
@@ -274,6 +293,42 @@ void PlayingSample::stop(float ramp) {
 	unlock();
 }
 
+void PlayingSample::set_state(PlayingSampleState const &state) {
+	lock();
+	assert(!data.empty());
+	i = std::min< uint32_t >(state.i, uint32_t(data.size()) - 1);
+	loop = state.loop;
+	position.set(state.position, 0.0f);
+	if (state.playing) {
+		stopped = false;
+		volume.set(state.volume, 0.0f);
+		if (finished) {
+			//move back from finished_samples (splicing, so nothing is allocated):
+			for (auto si = finished_samples.begin(); si != finished_samples.end(); ++si) {
+				if (si->get() != this) continue;
+				playing_samples.splice(playing_samples.end(), finished_samples, si);
+				break;
+			}
+			finished = false;
+		}
+	} else {
+		stop();
+	}
+	unlock();
+}
+
+PlayingSampleState PlayingSample::get_state() const {
+	PlayingSampleState state;
+	lock();
+	state.playing = !stopped && i < data.size();
+	state.i = i;
+	state.loop = loop;
+	state.position = position.target;
+	state.volume = volume.target;
+	unlock();
+	return state;
+}
+
 //------------------
 
 void Listener::set_position(glm::vec3 const &new_position, float ramp) {
@@ -11,6 +11,15 @@ namespace Sound {
 
 struct PlayingSample;
 
+//what a PlayingSample is doing, for saving and restoring game state (see PlayingSample::get_state):
+struct PlayingSampleState {
+	bool playing = false; //(false once stopped or finished)
+	uint32_t i = 0; //next data value to read
+	bool loop = false;
+	glm::vec3 position = glm::vec3(0.0f);
+	float volume = 1.0f;
+};
+
 enum LoopOrOnce {
 	Once,
 	Loop
@@ -31,6 +40,9 @@ struct Sample {
 		LoopOrOnce loop_or_once = Once
 	) const;
 
+	//start playing this sample from a saved PlayingSampleState (returns null if it wasn't playing):
+	std::shared_ptr< PlayingSample > play(PlayingSampleState const &state) const;
+
 	std::vector< float > data;
 };
 
@@ -61,11 +73,17 @@ struct PlayingSample {
 	void set_volume(float new_volume, float ramp = 1.0f / 60.0f);
 	void stop(float ramp = 1.0f / 60.0f);
 
+	//read position, position, and volume (as set, ignoring ramps) -- play() it to pick up from here:
+	PlayingSampleState get_state() const;
+	//pick up from a saved state in place (restarting playback, if it had finished, without allocating):
+	void set_state(PlayingSampleState const &state);
+
 	//internals:
 	std::vector< float > const &data; //reference to sample data being played
 	uint32_t i = 0; //next data value to read
 	bool loop = false; //should playback loop after data runs out?
 	bool stopped = false; //was playback stopped (either by running out of sample, or by stop())?
+	bool finished = false; //has the mixer dropped it (to finished_samples, because it is still held)?
 
 	Ramp< glm::vec3 > position = Ramp< glm::vec3 >(0.0f);
 	Ramp< float > volume = Ramp< float >(1.0f);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+#include <cstring>
+#include <cstddef>
+
+//"StateBlob" holds a snapshot of game state as raw bytes, written and read back in the same order.
+// Values are copied byte-for-byte, so they must be trivially copyable (no pointers you expect to
+// survive a restart, no std::vector's). Keeping a blob around and clear()'ing it before saving
+// again reuses its storage.
+//
+//Usage:
+// StateBlob blob;
+// blob.write(timer);
+// blob.write(positions.data(), positions.size());
+// ...
+// StateBlob::Reader reader(blob);
+// reader.read(&timer);
+// reader.read(positions.data(), positions.size());
+
+struct StateBlob {
+	std::vector< char > data;
+
+	void clear() { data.clear(); } //(keeps capacity)
+
+	template< typename T >
+	void write(T const *values, size_t count) {
+		static_assert(std::is_trivially_copyable< T >::value, "StateBlob only copies trivially copyable values.");
+		size_t at = data.size();
+		data.resize(at + sizeof(T) * count);
+		if (count) std::memcpy(&data[at], values, sizeof(T) * count);
+	}
+	template< typename T >
+	void write(T const &value) { write(&value, 1); }
+
+	struct Reader {
+		Reader(StateBlob const &blob_) : blob(blob_) { }
+		StateBlob const &blob;
+		size_t offset = 0; //(may be set to re-read part of the blob)
+
+		template< typename T >
+		void read(T *values, size_t count) {
+			static_assert(std::is_trivially_copyable< T >::value, "StateBlob only copies trivially copyable values.");
+			if (blob.data.size() - offset < sizeof(T) * count) {
+				throw std::runtime_error("Read past the end of a StateBlob (was it saved from something else?)");
+			}
+			if (count) std::memcpy(values, &blob.data[offset], sizeof(T) * count);
+			offset += sizeof(T) * count;
+		}
+		template< typename T >
+		void read(T *value) { read(value, 1); }
+
+		bool done() const { return offset == blob.data.size(); }
+	};
+};
@@ -0,0 +1,172 @@
+#include "StreamBuffer.hpp"
+
+#include "GLState.hpp"
+#include "gl_extensions.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <string>
+
+namespace {
+	//buffer storage is core in OpenGL 4.4 (or via ARB_buffer_storage), so look it up at runtime:
+	PFNGLBUFFERSTORAGEPROC buffer_storage() {
+		static PFNGLBUFFERSTORAGEPROC fn = [](){
+			if (!(gl_has_version(4,4) || gl_has_extension("GL_ARB_buffer_storage"))) return PFNGLBUFFERSTORAGEPROC(nullptr);
+			return gl_get_proc< PFNGLBUFFERSTORAGEPROC >("glBufferStorage");
+		}();
+		return fn;
+	}
+}
+
+std::vector< StreamBuffer * > &StreamBuffer::all() {
+	static std::vector< StreamBuffer * > buffers;
+	return buffers;
+}
+
+StreamBuffer::StreamBuffer(GLsizeiptr size_) : size(size_) {
+	if (size <= 0) throw std::runtime_error("StreamBuffer size must be positive.");
+
+	glGenBuffers(1, &vbo);
+	GLState::bind_buffer(GL_ARRAY_BUFFER, vbo);
+
+	if (auto BufferStorage = buffer_storage()) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		BufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+		mapped = reinterpret_cast< uint8_t * >(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+		if (mapped) {
+			persistent = true;
+		} else {
+			//buffer storage is immutable, so start over with a new buffer for the fallback path:
+			std::cerr << "WARNING: failed to persistently map stream buffer; falling back to orphaning." << std::endl;
+			glDeleteBuffers(1, &vbo);
+			GLState::forget_buffer(vbo);
+			glGenBuffers(1, &vbo);
+			GLState::bind_buffer(GL_ARRAY_BUFFER, vbo);
+		}
+	}
+	if (!persistent) {
+		glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		staging.resize(size);
+	}
+
+	all().emplace_back(this);
+}
+
+StreamBuffer::~StreamBuffer() {
+	auto &buffers = all();
+	buffers.erase(std::remove(buffers.begin(), buffers.end(), this), buffers.end());
+
+	for (auto const &f : fences) {
+		glDeleteSync(f.sync);
+	}
+	fences.clear();
+
+	if (mapped) {
+		GLState::bind_buffer(GL_ARRAY_BUFFER, vbo);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		mapped = nullptr;
+	}
+	glDeleteBuffers(1, &vbo);
+	GLState::forget_buffer(vbo);
+	vbo = 0;
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(GLsizeiptr bytes, GLsizeiptr alignment) {
+	if (bytes < 0 || bytes > size) {
+		throw std::runtime_error("StreamBuffer allocation of " + std::to_string(bytes) + " bytes doesn't fit in a buffer of " + std::to_string(size) + " bytes.");
+	}
+	if (alignment <= 0) alignment = 1;
+
+	//find an aligned spot that doesn't run off the end of the buffer:
+	uint64_t begin = head;
+	{
+		uint64_t physical = begin % size;
+		uint64_t aligned = (physical + alignment - 1) / alignment * alignment;
+		if (aligned + bytes > uint64_t(size)) {
+			begin = begin - physical + size; //wrap to the start of the buffer
+		} else {
+			begin += aligned - physical;
+		}
+	}
+	uint64_t end = begin + bytes;
+
+	if (persistent) {
+		//wait until the GPU is done with data from older frames that this allocation would overwrite:
+		while (end > retired + size) {
+			if (fences.empty()) {
+				throw std::runtime_error("StreamBuffer of " + std::to_string(size) + " bytes is too small for one frame's data.");
+			}
+			GLenum result = GL_TIMEOUT_EXPIRED;
+			while (result == GL_TIMEOUT_EXPIRED) {
+				result = glClientWaitSync(fences.front().sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ULL);
+			}
+			if (result == GL_WAIT_FAILED) {
+				std::cerr << "WARNING: waiting on stream buffer fence failed." << std::endl;
+			}
+			retired = fences.front().end;
+			glDeleteSync(fences.front().sync);
+			fences.pop_front();
+		}
+	} else if (end > retired + size) {
+		//everything in the current buffer storage is used; upload what's pending and orphan it:
+		upload();
+		GLState::bind_buffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		begin = begin - (begin % size) + ((begin % size) == 0 ? 0 : size); //the new storage starts at offset zero
+		end = begin + bytes;
+		retired = begin;
+	}
+
+	head = end;
+
+	Allocation ret;
+	ret.offset = GLintptr(begin % size);
+	if (persistent) {
+		ret.data = mapped + ret.offset;
+	} else {
+		ret.data = staging.data() + ret.offset;
+		if (dirty_begin == dirty_end) {
+			dirty_begin = begin;
+		}
+		dirty_end = end;
+	}
+	return ret;
+}
+
+void StreamBuffer::upload() {
+	if (persistent || dirty_begin == dirty_end) return;
+	//allocations since the last upload are contiguous and don't wrap (wrapping orphans, which uploads first):
+	GLState::bind_buffer(GL_ARRAY_BUFFER, vbo);
+	GLintptr offset = GLintptr(dirty_begin % size);
+	glBufferSubData(GL_ARRAY_BUFFER, offset, GLsizeiptr(dirty_end - dirty_begin), staging.data() + offset);
+	dirty_begin = dirty_end;
+}
+
+void StreamBuffer::fence() {
+	if (!persistent) {
+		upload();
+		return;
+	}
+	if (head == frame_begin) return; //nothing allocated this frame
+	Fence f;
+	f.end = head;
+	f.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	fences.emplace_back(f);
+	frame_begin = head;
+}
+
+void StreamBuffer::end_frame() {
+	for (auto buffer : all()) {
+		buffer->fence();
+	}
+}
+
+GLuint StreamBuffer::make_vao_for_program(GLuint program) const {
+	return MeshBuffer::make_vao_for_attribs(program, vbo, {
+		{"Position", Position},
+		{"Normal", Normal},
+		{"Color", Color},
+		{"TexCoord", TexCoord},
+	});
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "GL.hpp"
+#include "MeshBuffer.hpp"
+
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+//"StreamBuffer" is a vertex buffer for data that is rewritten every frame (text, debug lines, particles, ...).
+// It is used as a ring: allocate() hands out space after the previous allocation, wrapping around at the end.
+//
+//When ARB_buffer_storage (or OpenGL 4.4) is available, the buffer is persistently mapped and allocations
+// point straight into it. Each frame's region is fenced, and allocate() only waits if it would overwrite
+// data from a frame the GPU hasn't finished yet.
+//Otherwise, allocations point into a CPU-side copy that upload() copies to the buffer, and the buffer is
+// orphaned (glBufferData(..., NULL, ...)) on wrap-around so that the driver never has to wait.
+//
+//Usage:
+// StreamBuffer::Allocation a = stream.allocate(count * sizeof(Vertex), sizeof(Vertex));
+// ... write vertices to a.data ...
+// stream.upload(); //before drawing
+// glDrawArrays(GL_TRIANGLES, GLint(a.offset / sizeof(Vertex)), count); //using a vao from make_vao_for_program
+//...and StreamBuffer::end_frame() once per frame (main() does this after drawing).
+
+struct StreamBuffer {
+	//size is the total size of the ring in bytes; it should hold a few frames' worth of data:
+	StreamBuffer(GLsizeiptr size);
+	~StreamBuffer();
+	StreamBuffer(StreamBuffer const &) = delete;
+	StreamBuffer &operator=(StreamBuffer const &) = delete;
+
+	GLuint vbo = 0;
+	GLsizeiptr size = 0;
+	bool persistent = false; //using a persistent mapping (otherwise: staging + orphaning)
+
+	struct Allocation {
+		void *data = nullptr; //write here
+		GLintptr offset = 0; //offset of data in vbo
+	};
+	//reserve 'bytes' (starting at an offset that is a multiple of 'alignment'):
+	// note: throws if the request can't fit (even after waiting for the GPU).
+	Allocation allocate(GLsizeiptr bytes, GLsizeiptr alignment = 16);
+
+	//make data written since the last upload() visible to OpenGL (nothing to do if persistent):
+	void upload();
+
+	//call once per frame, after the frame's draws are submitted; fences this frame's allocations:
+	static void end_frame();
+
+	//vertex layout (same meaning as in MeshBuffer) and binding it to a program:
+	MeshBuffer::Attrib Position;
+	MeshBuffer::Attrib Normal;
+	MeshBuffer::Attrib Color;
+	MeshBuffer::Attrib TexCoord;
+	GLuint make_vao_for_program(GLuint program) const;
+
+	//internals:
+	//positions are measured in bytes since creation ("virtual" offsets), so the ring never needs to
+	// compare positions across a wrap: the physical offset is position % size.
+	uint64_t head = 0; //next free position
+	uint64_t retired = 0; //everything before this position is no longer in use by the GPU
+	uint64_t frame_begin = 0; //position at the start of the current frame
+	struct Fence {
+		uint64_t end; //position at the end of the frame
+		GLsync sync;
+	};
+	std::deque< Fence > fences; //oldest first
+	void fence();
+
+	uint8_t *mapped = nullptr; //persistent mapping
+	std::vector< uint8_t > staging; //CPU-side copy (not persistent)
+	uint64_t dirty_begin = 0, dirty_end = 0; //staging range not yet uploaded
+
+	static std::vector< StreamBuffer * > &all();
+};
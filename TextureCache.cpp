@@ -0,0 +1,316 @@
+#include "TextureCache.hpp"
+
+#include "load_png.hpp"
+#include "data_path.hpp"
+#include "gl_errors.hpp"
+#include "Jobs.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace TextureCache {
+
+namespace {
+//local data:
+
+//pixels of padding around atlas entries (edge pixels are repeated into it); mipmap levels
+// of atlas pages stop where the padding would shrink below one texel:
+constexpr const uint32_t AtlasPadding = 4;
+constexpr const GLint AtlasMaxLevel = 2;
+
+struct Entry {
+	Texture texture;
+	std::string name;
+	uint32_t flags = 0;
+	uint32_t refs = 0;
+	uint64_t serial = 0; //identifies this load (names can be released and acquired again while decoding)
+	uint32_t page = -1U; //atlas page holding this texture (or -1U)
+};
+std::unordered_map< std::string, std::unique_ptr< Entry > > entries;
+uint64_t next_serial = 1;
+uint32_t in_flight = 0; //decodes submitted but not yet uploaded or discarded
+
+GLuint placeholder = 0;
+
+//---- atlas pages ----
+struct Page {
+	GLuint tex = 0;
+	uint32_t x = 0; //next free spot on the current shelf
+	uint32_t shelf_y = 0; //bottom of the current shelf
+	uint32_t shelf_height = 0;
+	uint32_t live = 0; //textures using this page
+	bool dirty = false; //needs mipmaps regenerated
+};
+std::vector< Page > pages;
+
+//find room for a (padded) rectangle using simple shelf packing:
+bool pack(glm::uvec2 const &size, uint32_t *page_index, glm::uvec2 *at) {
+	//(the page is only changed if the rectangle fits, so a failed try doesn't waste the rest of a shelf)
+	auto try_page = [&](Page &page) -> bool {
+		uint32_t x = page.x;
+		uint32_t shelf_y = page.shelf_y;
+		uint32_t shelf_height = page.shelf_height;
+		if (x + size.x > AtlasPageSize) { //would need a new shelf
+			shelf_y += shelf_height;
+			x = 0;
+			shelf_height = 0;
+		}
+		if (shelf_y + size.y > AtlasPageSize || x + size.x > AtlasPageSize) return false;
+		*at = glm::uvec2(x, shelf_y);
+		page.x = x + size.x;
+		page.shelf_y = shelf_y;
+		page.shelf_height = std::max(shelf_height, size.y);
+		return true;
+	};
+	for (uint32_t i = 0; i < pages.size(); ++i) {
+		if (pages[i].tex != 0 && try_page(pages[i])) {
+			*page_index = i;
+			return true;
+		}
+	}
+	//need a new page (reuse a freed slot if there is one):
+	uint32_t index = 0;
+	while (index < pages.size() && pages[index].tex != 0) ++index;
+	if (index == pages.size()) pages.emplace_back();
+	Page &page = pages[index];
+	page = Page();
+	glGenTextures(1, &page.tex);
+	glBindTexture(GL_TEXTURE_2D, page.tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, AtlasPageSize, AtlasPageSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, AtlasMaxLevel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	*page_index = index;
+	return try_page(page);
+}
+
+//---- decoding (as jobs, see Jobs.hpp) ----
+struct Decoded {
+	std::string name;
+	uint64_t serial;
+	glm::uvec2 size = glm::uvec2(0);
+	std::vector< glm::u8vec4 > data;
+	std::string error; //non-empty if decoding failed
+};
+
+struct Decoder {
+	Jobs::Group decoding;
+	std::mutex mutex; //guards 'done'
+	std::deque< Decoded > done;
+
+	void decode(std::string const &name, uint64_t serial) {
+		Decoded decoded;
+		decoded.name = name;
+		decoded.serial = serial;
+		try {
+			load_png(data_path(name), &decoded.size, &decoded.data, LowerLeftOrigin);
+		} catch (std::exception &e) {
+			decoded.error = e.what();
+		}
+
+		std::unique_lock< std::mutex > lock(mutex);
+		done.emplace_back(std::move(decoded));
+	}
+};
+Decoder &decoder() {
+	static Decoder w;
+	return w;
+}
+
+//upload a decoded image to its texture (runs on the main thread):
+void upload(Entry &entry, Decoded const &decoded) {
+	Texture &texture = entry.texture;
+	if (!decoded.error.empty()) {
+		std::cerr << "WARNING: " << decoded.error << std::endl;
+		texture.failed = true;
+		return;
+	}
+	texture.size = decoded.size;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	uint32_t page_index = -1U;
+	glm::uvec2 at = glm::uvec2(0);
+	glm::uvec2 padded = decoded.size + glm::uvec2(2 * AtlasPadding);
+	if ((entry.flags & Atlas)
+	 && decoded.size.x <= AtlasMaxSize && decoded.size.y <= AtlasMaxSize
+	 && pack(padded, &page_index, &at)) {
+		//copy into a padded image, repeating the edge pixels:
+		std::vector< glm::u8vec4 > data(padded.x * padded.y);
+		for (uint32_t y = 0; y < padded.y; ++y) {
+			uint32_t sy = std::min(decoded.size.y - 1, uint32_t(std::max(0, int32_t(y) - int32_t(AtlasPadding))));
+			for (uint32_t x = 0; x < padded.x; ++x) {
+				uint32_t sx = std::min(decoded.size.x - 1, uint32_t(std::max(0, int32_t(x) - int32_t(AtlasPadding))));
+				data[y * padded.x + x] = decoded.data[sy * decoded.size.x + sx];
+			}
+		}
+		Page &page = pages[page_index];
+		glBindTexture(GL_TEXTURE_2D, page.tex);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, at.x, at.y, padded.x, padded.y, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+		glBindTexture(GL_TEXTURE_2D, 0);
+		page.live += 1;
+		page.dirty = true;
+
+		entry.page = page_index;
+		texture.tex = page.tex;
+		texture.uv_offset = glm::vec2(at + glm::uvec2(AtlasPadding)) / float(AtlasPageSize);
+		texture.uv_scale = glm::vec2(decoded.size) / float(AtlasPageSize);
+	} else {
+		GLuint tex = 0;
+		glGenTextures(1, &tex);
+		glBindTexture(GL_TEXTURE_2D, tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, decoded.size.x, decoded.size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, decoded.data.data());
+		if (entry.flags & Mipmaps) {
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		} else {
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		texture.tex = tex;
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	texture.ready = true;
+}
+
+//handle one decoded image (upload it, or drop it if its texture has been released since):
+void receive(Decoded const &decoded) {
+	in_flight -= 1;
+	auto f = entries.find(decoded.name);
+	if (f == entries.end() || f->second->serial != decoded.serial) return;
+	upload(*f->second, decoded);
+}
+
+void generate_atlas_mipmaps() {
+	for (auto &page : pages) {
+		if (!page.dirty) continue;
+		glBindTexture(GL_TEXTURE_2D, page.tex);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		page.dirty = false;
+	}
+}
+
+} //end anon namespace
+
+//------------------
+
+Texture const *acquire(std::string const &name, uint32_t flags) {
+	auto f = entries.find(name);
+	if (f != entries.end()) {
+		f->second->refs += 1;
+		return &f->second->texture;
+	}
+
+	if (placeholder == 0) {
+		glm::u8vec4 white(0xff, 0xff, 0xff, 0xff);
+		glGenTextures(1, &placeholder);
+		glBindTexture(GL_TEXTURE_2D, placeholder);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &white);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	std::unique_ptr< Entry > entry(new Entry);
+	entry->name = name;
+	entry->flags = flags;
+	entry->refs = 1;
+	entry->serial = next_serial++;
+	entry->texture.tex = placeholder;
+
+	Decoder &w = decoder();
+	uint64_t serial = entry->serial;
+	Jobs::run([&w, name, serial](){ w.decode(name, serial); }, &w.decoding);
+	in_flight += 1;
+
+	Texture const *ret = &entry->texture;
+	entries.emplace(name, std::move(entry));
+	return ret;
+}
+
+void release(Texture const *texture) {
+	if (!texture) return;
+	for (auto f = entries.begin(); f != entries.end(); ++f) {
+		Entry &entry = *f->second;
+		if (&entry.texture != texture) continue;
+		assert(entry.refs > 0);
+		entry.refs -= 1;
+		if (entry.refs > 0) return;
+
+		if (entry.page != -1U) {
+			Page &page = pages[entry.page];
+			assert(page.live > 0);
+			page.live -= 1;
+			if (page.live == 0) {
+				//(space in a page is only reclaimed once everything in it is released)
+				glDeleteTextures(1, &page.tex);
+				page = Page();
+			}
+		} else if (entry.texture.tex != placeholder) {
+			glDeleteTextures(1, &entry.texture.tex);
+		}
+		//(if still decoding, the result will be dropped when it arrives)
+		entries.erase(f);
+		return;
+	}
+	std::cerr << "WARNING: releasing a texture that isn't in the cache." << std::endl;
+}
+
+void update(float budget_ms) {
+	if (in_flight == 0) return;
+	Decoder &w = decoder();
+	auto start = std::chrono::high_resolution_clock::now();
+	while (true) {
+		Decoded decoded;
+		{
+			std::unique_lock< std::mutex > lock(w.mutex);
+			if (w.done.empty()) break;
+			decoded = std::move(w.done.front());
+			w.done.pop_front();
+		}
+		receive(decoded);
+		float elapsed = std::chrono::duration< float, std::milli >(std::chrono::high_resolution_clock::now() - start).count();
+		if (elapsed > budget_ms) break;
+	}
+	generate_atlas_mipmaps();
+	GL_ERRORS();
+}
+
+void finish_all() {
+	Decoder &w = decoder();
+	//(helps decode, rather than just waiting)
+	w.decoding.wait();
+	while (in_flight > 0) {
+		Decoded decoded;
+		{
+			std::unique_lock< std::mutex > lock(w.mutex);
+			assert(!w.done.empty() && "Every decode is done.");
+			decoded = std::move(w.done.front());
+			w.done.pop_front();
+		}
+		receive(decoded);
+	}
+	generate_atlas_mipmaps();
+	GL_ERRORS();
+}
+
+uint32_t pending() {
+	return in_flight;
+}
+
+} //namespace TextureCache
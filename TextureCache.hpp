@@ -0,0 +1,54 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <cstdint>
+
+//"TextureCache" loads .png textures without blocking the main thread:
+// acquire() returns immediately; decoding happens in jobs (see Jobs.hpp), and decoded images are
+// uploaded (with mipmaps) by update(), which main() calls once per frame with a time budget.
+//Until its upload is done, a texture is drawn as a 1x1 white placeholder, so code can bind
+// 'tex' right away.
+//
+//Textures are shared by name and reference counted: each acquire() needs a matching release().
+//
+//Small textures acquired with the Atlas flag are packed into shared atlas pages; use
+// uv * uv_scale + uv_offset to address them (for other textures, uv_scale is 1 and uv_offset is 0).
+// Atlas textures can't repeat, and their mipmaps are limited so that neighbors don't bleed together.
+
+struct Texture {
+	GLuint tex = 0; //the placeholder until 'ready'
+	glm::uvec2 size = glm::uvec2(0);
+	glm::vec2 uv_offset = glm::vec2(0.0f);
+	glm::vec2 uv_scale = glm::vec2(1.0f);
+	bool ready = false;
+	bool failed = false; //decoding failed; stays the placeholder
+};
+
+namespace TextureCache {
+
+enum Flags : uint32_t {
+	Mipmaps = 1, //generate mipmaps and use trilinear filtering
+	Atlas = 2, //pack into an atlas page if small enough (at most AtlasMaxSize on a side)
+};
+constexpr const uint32_t AtlasMaxSize = 128;
+constexpr const uint32_t AtlasPageSize = 1024;
+
+//get a texture by file name (relative to data_path); must be called on the main thread after the context is created:
+// (flags only matter for the first acquire of a name)
+Texture const *acquire(std::string const &name, uint32_t flags = Mipmaps);
+//drop a reference; the texture is freed when the last reference is released:
+void release(Texture const *texture);
+
+//upload finished decodes, spending at most about 'budget_ms' (but always making some progress):
+void update(float budget_ms = 2.0f);
+//wait for every pending texture to be decoded and uploaded (e.g. during loading, where blocking is fine):
+void finish_all();
+
+//number of textures still being decoded or waiting for upload:
+uint32_t pending();
+
+} //namespace TextureCache
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "GL.hpp"
+#include "MeshBuffer.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//VertexLayout describes a packed vertex format as a list of attributes, e.g.
+//   typedef VertexLayout< VertexAttribs::Position, VertexAttribs::Normal, VertexAttribs::Color > PNC;
+//and derives everything else from that one declaration:
+//   PNC::Stride             -- bytes per vertex (attributes are tightly packed, in order)
+//   PNC::offset< A >()      -- byte offset of attribute A
+//   PNC::Vertex             -- a Stride-byte struct, for reading vertex chunks (see read_chunk.hpp)
+//   PNC::magic()            -- chunk magic, one letter per attribute padded with '.' ("pnc.")
+//   PNC::extension()        -- file extension (".pnc")
+//   PNC::attribs()          -- (name, MeshBuffer::Attrib) list, for GeometryArena / make_vao_for_attribs
+//   PNC::set_attribs(&mb)   -- fill in a MeshBuffer's Attrib members
+//
+//Attributes are described by tag structs (see VertexAttribs below); a new tag is all it takes to
+// support a new attribute or a more compact encoding of an existing one.
+
+namespace VertexAttribs {
+
+//Each tag gives: the C++ type stored per vertex, the glVertexAttribPointer parameters,
+// the letter used in chunk magic and file extensions, the shader attribute name,
+// and the MeshBuffer member that records where it is.
+struct Position {
+	typedef glm::vec3 Type;
+	static constexpr const GLint Size = 3;
+	static constexpr const GLenum GLType = GL_FLOAT;
+	static constexpr const GLboolean Normalized = GL_FALSE;
+	static constexpr const char Letter = 'p';
+	static char const *name() { return "Position"; }
+	static MeshBuffer::Attrib MeshBuffer::*member() { return &MeshBuffer::Position; }
+};
+struct Normal {
+	typedef glm::vec3 Type;
+	static constexpr const GLint Size = 3;
+	static constexpr const GLenum GLType = GL_FLOAT;
+	static constexpr const GLboolean Normalized = GL_FALSE;
+	static constexpr const char Letter = 'n';
+	static char const *name() { return "Normal"; }
+	static MeshBuffer::Attrib MeshBuffer::*member() { return &MeshBuffer::Normal; }
+};
+struct Color {
+	typedef glm::u8vec4 Type;
+	static constexpr const GLint Size = 4;
+	static constexpr const GLenum GLType = GL_UNSIGNED_BYTE;
+	static constexpr const GLboolean Normalized = GL_TRUE;
+	static constexpr const char Letter = 'c';
+	static char const *name() { return "Color"; }
+	static MeshBuffer::Attrib MeshBuffer::*member() { return &MeshBuffer::Color; }
+};
+struct TexCoord {
+	typedef glm::vec2 Type;
+	static constexpr const GLint Size = 2;
+	static constexpr const GLenum GLType = GL_FLOAT;
+	static constexpr const GLboolean Normalized = GL_FALSE;
+	static constexpr const char Letter = 't';
+	static char const *name() { return "TexCoord"; }
+	static MeshBuffer::Attrib MeshBuffer::*member() { return &MeshBuffer::TexCoord; }
+};
+
+} //namespace VertexAttribs
+
+//---- compile-time helpers ----
+
+namespace VertexLayoutDetail {
+	//sum of sizeof(A::Type) over a list of attributes:
+	template< typename... As > struct Bytes;
+	template< > struct Bytes< > {
+		static constexpr const size_t value = 0;
+	};
+	template< typename A, typename... Rest > struct Bytes< A, Rest... > {
+		static constexpr const size_t value = sizeof(typename A::Type) + Bytes< Rest... >::value;
+	};
+
+	//bytes before attribute 'Target' in a list of attributes:
+	template< typename Target, typename... As > struct Offset;
+	template< typename Target, typename... Rest > struct Offset< Target, Target, Rest... > {
+		static constexpr const size_t value = 0;
+	};
+	template< typename Target, typename A, typename... Rest > struct Offset< Target, A, Rest... > {
+		static constexpr const size_t value = sizeof(typename A::Type) + Offset< Target, Rest... >::value;
+	};
+
+	//bytes taken by an attribute with the given glVertexAttribPointer size and type:
+	constexpr size_t attrib_bytes(GLint size, GLenum type) {
+		return (type == GL_INT_2_10_10_10_REV || type == GL_UNSIGNED_INT_2_10_10_10_REV) ? 4
+			: size_t(size) * ((type == GL_FLOAT || type == GL_INT || type == GL_UNSIGNED_INT) ? 4
+			: (type == GL_HALF_FLOAT || type == GL_SHORT || type == GL_UNSIGNED_SHORT) ? 2
+			: 1);
+	}
+
+	//true if every attribute's Type is exactly what OpenGL will read, and keeps the next attribute 4-byte aligned:
+	template< typename... As > struct Packed;
+	template< > struct Packed< > {
+		static constexpr const bool value = true;
+	};
+	template< typename A, typename... Rest > struct Packed< A, Rest... > {
+		static constexpr const bool value =
+			sizeof(typename A::Type) == attrib_bytes(A::Size, A::GLType)
+			&& sizeof(typename A::Type) % 4 == 0
+			&& Packed< Rest... >::value;
+	};
+}
+
+template< typename... As >
+struct VertexLayout {
+	static_assert(sizeof...(As) >= 1 && sizeof...(As) <= 4, "Layouts have one to four attributes (chunk magic is four letters).");
+	static_assert(VertexLayoutDetail::Packed< As... >::value, "Attribute types must match their GL size and type, and be a multiple of four bytes.");
+
+	static constexpr const size_t Stride = VertexLayoutDetail::Bytes< As... >::value;
+
+	template< typename A >
+	static constexpr size_t offset() {
+		return VertexLayoutDetail::Offset< A, As... >::value;
+	}
+
+	struct Vertex {
+		uint8_t bytes[Stride];
+	};
+	static_assert(sizeof(Vertex) == Stride, "Vertex is packed.");
+
+	static std::string letters() {
+		char const list[] = { As::Letter..., '\0' };
+		return std::string(list);
+	}
+	static std::string magic() {
+		std::string ret = letters();
+		while (ret.size() < 4) ret += '.';
+		return ret;
+	}
+	static std::string extension() {
+		return "." + letters();
+	}
+
+	static std::vector< std::pair< char const *, MeshBuffer::Attrib > > attribs() {
+		return {
+			{ As::name(), MeshBuffer::Attrib(As::Size, As::GLType, As::Normalized, GLsizei(Stride), GLsizei(offset< As >())) }...
+		};
+	}
+
+	static void set_attribs(MeshBuffer *buffer) {
+		int expand[] = {
+			((buffer->*As::member() = MeshBuffer::Attrib(As::Size, As::GLType, As::Normalized, GLsizei(Stride), GLsizei(offset< As >()))), 0)...
+		};
+		(void)expand;
+	}
+};
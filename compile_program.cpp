@@ -1,52 +1,301 @@
 #include "compile_program.hpp"
 
+#include "gl_extensions.hpp"
+#include "data_path.hpp"
+#include "read_chunk.hpp"
+#include "write_chunk.hpp"
+
 #include <vector>
 #include <string>
 #include <stdexcept>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <unordered_map>
 
-static GLuint compile_shader(GLenum type, std::string const &source) {
-	GLuint shader = glCreateShader(type);
-	GLchar const *str = source.c_str();
-	GLint length = GLint(source.size());
-	glShaderSource(shader, 1, &str, &length);
-	glCompileShader(shader);
-	GLint compile_status = GL_FALSE;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
-	if (compile_status != GL_TRUE) {
-		std::cerr << "Failed to compile shader." << std::endl;
-		GLint info_log_length = 0;
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_length);
-		std::vector< GLchar > info_log(info_log_length, 0);
-		GLsizei length = 0;
-		glGetShaderInfoLog(shader, GLint(info_log.size()), &length, &info_log[0]);
-		std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
-		glDeleteShader(shader);
-		throw std::runtime_error("Failed to compile shader.");
+//------ program binary cache ------
+//Linked programs are saved (via glGetProgramBinary) to files in user_path(),
+// named by a hash of the shader sources and the GL vendor/renderer/version strings.
+//On later runs those binaries are loaded (via glProgramBinary) instead of compiling from source.
+
+namespace {
+	//program binaries are core in OpenGL 4.1 (or via ARB_get_program_binary), so look them up at runtime:
+	struct ProgramBinaryFunctions {
+		PFNGLGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+		PFNGLPROGRAMBINARYPROC ProgramBinary = nullptr;
+		PFNGLPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+		bool supported = false;
+
+		ProgramBinaryFunctions() {
+			if (!(gl_has_version(4,1) || gl_has_extension("GL_ARB_get_program_binary"))) return;
+			GetProgramBinary = gl_get_proc< PFNGLGETPROGRAMBINARYPROC >("glGetProgramBinary");
+			ProgramBinary = gl_get_proc< PFNGLPROGRAMBINARYPROC >("glProgramBinary");
+			ProgramParameteri = gl_get_proc< PFNGLPROGRAMPARAMETERIPROC >("glProgramParameteri");
+			GLint formats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+			supported = (GetProgramBinary && ProgramBinary && ProgramParameteri && formats > 0);
+		}
+	};
+
+	ProgramBinaryFunctions const &program_binary_functions() {
+		static ProgramBinaryFunctions functions;
+		return functions;
+	}
+
+	//64-bit FNV-1a hash:
+	void hash_bytes(uint64_t *hash, char const *begin, size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			*hash ^= uint8_t(begin[i]);
+			*hash *= 0x100000001b3ULL;
+		}
+	}
+	void hash_string(uint64_t *hash, std::string const &str) {
+		//include the terminating '\0' so that ("ab","c") and ("a","bc") hash differently:
+		hash_bytes(hash, str.c_str(), str.size() + 1);
+	}
+
+	uint64_t program_cache_key(std::string const &vertex_shader_source, std::string const &fragment_shader_source) {
+		auto gl_string = [](GLenum name) -> std::string {
+			GLubyte const *str = glGetString(name);
+			return str ? reinterpret_cast< char const * >(str) : "";
+		};
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		hash_string(&hash, gl_string(GL_VENDOR));
+		hash_string(&hash, gl_string(GL_RENDERER));
+		hash_string(&hash, gl_string(GL_VERSION));
+		hash_string(&hash, vertex_shader_source);
+		hash_string(&hash, fragment_shader_source);
+		return hash;
+	}
+
+	std::string program_cache_path(uint64_t key) {
+		std::ostringstream name;
+		name << "program-" << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+		return user_path(name.str());
+	}
+
+	//Program binary file format:
+	// "pbk0" chunk with the cache key (guards against truncated or renamed files)
+	// "pbf0" chunk with the binary format enum
+	// "pbd0" chunk with the binary data
+
+	//loads a cached binary into 'program'; returns false if no usable cached binary exists:
+	// (link status is checked later, by finish_program, so that loading doesn't stall)
+	bool load_cached_program(GLuint program, uint64_t key) {
+		ProgramBinaryFunctions const &gl = program_binary_functions();
+		if (!gl.supported) return false;
+
+		std::string path = program_cache_path(key);
+		std::ifstream file(path, std::ios::binary);
+		if (!file) return false;
+
+		std::vector< uint64_t > stored_key;
+		std::vector< GLenum > format;
+		std::vector< char > data;
+		try {
+			read_chunk(file, "pbk0", &stored_key);
+			read_chunk(file, "pbf0", &format);
+			read_chunk(file, "pbd0", &data);
+		} catch (std::exception &e) {
+			std::cerr << "WARNING: ignoring malformed program cache file '" << path << "' (" << e.what() << ")." << std::endl;
+			return false;
+		}
+		if (stored_key.size() != 1 || stored_key[0] != key || format.size() != 1 || data.empty()) {
+			std::cerr << "WARNING: ignoring mismatched program cache file '" << path << "'." << std::endl;
+			return false;
+		}
+
+		gl.ProgramBinary(program, format[0], data.data(), GLsizei(data.size()));
+		return true;
+	}
+
+	void store_cached_program(uint64_t key, GLuint program) {
+		ProgramBinaryFunctions const &gl = program_binary_functions();
+		if (!gl.supported) return;
+
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) return;
+
+		std::vector< uint64_t > stored_key(1, key);
+		std::vector< GLenum > format(1, 0);
+		std::vector< char > data(length);
+		GLsizei written = 0;
+		gl.GetProgramBinary(program, length, &written, &format[0], data.data());
+		if (written <= 0) return;
+		data.resize(written);
+
+		std::string path = program_cache_path(key);
+		std::ofstream file(path, std::ios::binary);
+		try {
+			write_chunk(file, "pbk0", stored_key);
+			write_chunk(file, "pbf0", format);
+			write_chunk(file, "pbd0", data);
+		} catch (std::exception &e) {
+			//the cache is only an optimization, so failing to write it isn't fatal:
+			std::cerr << "WARNING: failed to write program cache file '" << path << "' (" << e.what() << ")." << std::endl;
+			file.close();
+			std::remove(path.c_str());
+		}
 	}
-	return shader;
 }
 
-GLuint compile_program(
+//------ deferred compilation ------
+//submit_program() hands shader sources to the driver and returns right away;
+// status checks (which would force the driver to finish) are postponed to finish_program().
+//When KHR/ARB_parallel_shader_compile is available the driver compiles on its own threads meanwhile.
+
+namespace {
+	struct ParallelCompileFunctions {
+		PFNGLMAXSHADERCOMPILERTHREADSARBPROC MaxShaderCompilerThreads = nullptr;
+		bool supported = false;
+
+		ParallelCompileFunctions() {
+			if (gl_has_extension("GL_KHR_parallel_shader_compile")) {
+				MaxShaderCompilerThreads = gl_get_proc< PFNGLMAXSHADERCOMPILERTHREADSARBPROC >("glMaxShaderCompilerThreadsKHR");
+			} else if (gl_has_extension("GL_ARB_parallel_shader_compile")) {
+				MaxShaderCompilerThreads = gl_get_proc< PFNGLMAXSHADERCOMPILERTHREADSARBPROC >("glMaxShaderCompilerThreadsARB");
+			}
+			supported = (MaxShaderCompilerThreads != nullptr);
+			if (supported) {
+				//0xFFFFFFFF lets the driver pick the number of compiler threads:
+				MaxShaderCompilerThreads(0xFFFFFFFF);
+			}
+		}
+	};
+
+	ParallelCompileFunctions const &parallel_compile_functions() {
+		static ParallelCompileFunctions functions;
+		return functions;
+	}
+
+	//bookkeeping for programs that were submitted but not yet finished:
+	struct PendingProgram {
+		std::string vertex_shader_source;
+		std::string fragment_shader_source;
+		uint64_t cache_key = 0;
+		bool from_cache = false; //loaded via glProgramBinary (no shaders attached)
+		GLuint vertex_shader = 0;
+		GLuint fragment_shader = 0;
+	};
+
+	std::unordered_map< GLuint, PendingProgram > &pending_programs() {
+		static std::unordered_map< GLuint, PendingProgram > pending;
+		return pending;
+	}
+
+	GLuint start_shader(GLenum type, std::string const &source) {
+		GLuint shader = glCreateShader(type);
+		GLchar const *str = source.c_str();
+		GLint length = GLint(source.size());
+		glShaderSource(shader, 1, &str, &length);
+		glCompileShader(shader);
+		return shader;
+	}
+
+	//compile + link from source into 'program' without checking status:
+	void start_program_from_source(GLuint program, PendingProgram *pending) {
+		pending->from_cache = false;
+		pending->vertex_shader = start_shader(GL_VERTEX_SHADER, pending->vertex_shader_source);
+		pending->fragment_shader = start_shader(GL_FRAGMENT_SHADER, pending->fragment_shader_source);
+		glAttachShader(program, pending->vertex_shader);
+		glAttachShader(program, pending->fragment_shader);
+
+		//ask the driver to keep the linked binary around so it can be cached:
+		if (program_binary_functions().supported) {
+			program_binary_functions().ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+
+		glLinkProgram(program);
+	}
+
+	//throws (after printing the info log) if 'shader' failed to compile:
+	void check_shader(GLuint shader) {
+		GLint compile_status = GL_FALSE;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
+		if (compile_status != GL_TRUE) {
+			std::cerr << "Failed to compile shader." << std::endl;
+			GLint info_log_length = 0;
+			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_length);
+			std::vector< GLchar > info_log(info_log_length, 0);
+			GLsizei length = 0;
+			glGetShaderInfoLog(shader, GLint(info_log.size()), &length, &info_log[0]);
+			std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
+			throw std::runtime_error("Failed to compile shader.");
+		}
+	}
+}
+
+//----------------------------------
+
+GLuint submit_program(
 	std::string const &vertex_shader_source,
 	std::string const &fragment_shader_source
 	) {
 
-	GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
-	GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
+	parallel_compile_functions(); //make sure parallel compilation (if available) is enabled before submitting
 
 	GLuint program = glCreateProgram();
-	glAttachShader(program, vertex_shader);
-	glAttachShader(program, fragment_shader);
+	PendingProgram &pending = pending_programs()[program];
+	pending.vertex_shader_source = vertex_shader_source;
+	pending.fragment_shader_source = fragment_shader_source;
+	pending.cache_key = program_cache_key(vertex_shader_source, fragment_shader_source);
+
+	if (load_cached_program(program, pending.cache_key)) {
+		pending.from_cache = true;
+	} else {
+		start_program_from_source(program, &pending);
+	}
+
+	return program;
+}
+
+bool program_ready(GLuint program) {
+	auto f = pending_programs().find(program);
+	if (f == pending_programs().end()) return true; //already finished
+	if (!parallel_compile_functions().supported) return true; //can't tell without blocking; finish_program() will wait
+	GLint completion_status = GL_FALSE;
+	glGetProgramiv(program, GL_COMPLETION_STATUS_ARB, &completion_status);
+	return completion_status == GL_TRUE;
+}
 
-	//shaders are reference counted so this makes sure they are freed after program is deleted:
-	glDeleteShader(vertex_shader);
-	glDeleteShader(fragment_shader);
+void finish_program(GLuint program) {
+	auto f = pending_programs().find(program);
+	if (f == pending_programs().end()) return; //already finished
+	PendingProgram pending = f->second;
+	pending_programs().erase(f);
 
-	//link the shader program and throw errors if linking fails:
-	glLinkProgram(program);
 	GLint link_status = GL_FALSE;
 	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+
+	if (link_status != GL_TRUE && pending.from_cache) {
+		//binary was rejected (e.g. driver update); recompile from source and overwrite:
+		std::cerr << "NOTE: cached program binary '" << program_cache_path(pending.cache_key) << "' was rejected by the driver; recompiling." << std::endl;
+		std::remove(program_cache_path(pending.cache_key).c_str());
+		start_program_from_source(program, &pending);
+		glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+	}
+
+	if (!pending.from_cache) {
+		//report compile errors (if any) and release the shaders:
+		// (shaders are reference counted so deleting them here frees them once the program is deleted)
+		try {
+			check_shader(pending.vertex_shader);
+			check_shader(pending.fragment_shader);
+		} catch (...) {
+			glDeleteShader(pending.vertex_shader);
+			glDeleteShader(pending.fragment_shader);
+			throw;
+		}
+		glDetachShader(program, pending.vertex_shader);
+		glDetachShader(program, pending.fragment_shader);
+		glDeleteShader(pending.vertex_shader);
+		glDeleteShader(pending.fragment_shader);
+	}
+
+	//throw errors if linking failed:
 	if (link_status != GL_TRUE) {
 		std::cerr << "Failed to link shader program." << std::endl;
 		GLint info_log_length = 0;
@@ -58,5 +307,16 @@ GLuint compile_program(
 		throw std::runtime_error("failed to link program");
 	}
 
+	if (!pending.from_cache) {
+		store_cached_program(pending.cache_key, program);
+	}
+}
+
+GLuint compile_program(
+	std::string const &vertex_shader_source,
+	std::string const &fragment_shader_source
+	) {
+	GLuint program = submit_program(vertex_shader_source, fragment_shader_source);
+	finish_program(program);
 	return program;
 }
@@ -6,6 +6,24 @@
 
 //compiles+links an OpenGL shader program from source.
 // throws on compilation error.
+// linked programs are cached on disk (see user_path()) and re-loaded as binaries when the
+// sources and the OpenGL driver match; rejected or stale binaries fall back to compiling from source.
+// (this is submit_program() followed immediately by finish_program())
 GLuint compile_program(
 	std::string const &vertex_shader_source,
 	std::string const &fragment_shader_source);
+
+//starts compiling+linking a program and returns its name without waiting for the driver.
+// compile and link errors are reported later, by finish_program().
+// (uses KHR/ARB_parallel_shader_compile, when available, so the driver compiles in the background)
+GLuint submit_program(
+	std::string const &vertex_shader_source,
+	std::string const &fragment_shader_source);
+
+//returns true if a submitted program is done compiling+linking; never blocks.
+// (without parallel shader compile support this can't be known, so it always returns true)
+bool program_ready(GLuint program);
+
+//waits for a submitted program to finish linking; throws on compilation or link error.
+// must be called before querying uniform/attribute locations of a submitted program.
+void finish_program(GLuint program);
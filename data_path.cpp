@@ -12,11 +12,15 @@
 #include <io.h>
 #elif defined(__APPLE__)
 #include <mach-o/dyld.h>
+#include <sys/stat.h>
 #elif defined(__linux__)
 #include <unistd.h>
 #include <sys/stat.h>
 #endif //WINDOWS
 
+#include <cstdlib>
+#include <cerrno>
+
 //get_data_path() gets the directory containing the executable
 //  (...or the Resources directory on OSX if the code appears to be running in an app bundle)
 
@@ -71,3 +75,52 @@ std::string data_path(std::string const &suffix) {
 	static std::string path = get_data_path();
 	return path + "/" + suffix;
 }
+
+//get_user_path() gets (and creates, if needed) a per-user directory for writable game data:
+
+static std::string get_user_path() {
+	//name of the per-user folder that holds this game's data:
+	std::string const folder = "now-you-hear-me";
+
+	#if defined(_WIN32)
+	std::string ret;
+	PWSTR wpath = NULL;
+	if (SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, NULL, &wpath) == S_OK) {
+		std::vector< char > buffer(4 * MAX_PATH, '\0');
+		WideCharToMultiByte(CP_UTF8, 0, wpath, -1, &buffer[0], int(buffer.size()), NULL, NULL);
+		ret = std::string(&buffer[0]) + "\\" + folder;
+	}
+	CoTaskMemFree(wpath);
+	if (ret.empty()) return get_data_path();
+	_mkdir(ret.c_str());
+	return ret;
+
+	#elif defined(__linux__) || defined(__APPLE__)
+	std::string base;
+	#if defined(__APPLE__)
+	if (char const *home = getenv("HOME")) base = std::string(home) + "/Library/Application Support";
+	#else
+	if (char const *xdg = getenv("XDG_DATA_HOME")) base = xdg;
+	else if (char const *home = getenv("HOME")) base = std::string(home) + "/.local/share";
+	#endif
+	if (base.empty()) return get_data_path();
+	std::string ret = base + "/" + folder;
+	//create the folder (and any missing parents):
+	for (size_t slash = ret.find('/', 1); slash != std::string::npos; slash = ret.find('/', slash + 1)) {
+		mkdir(ret.substr(0, slash).c_str(), 0755);
+	}
+	if (mkdir(ret.c_str(), 0755) != 0 && errno != EEXIST) {
+		std::cerr << "WARNING: failed to create user directory '" << ret << "'; using data path instead." << std::endl;
+		return get_data_path();
+	}
+	return ret;
+
+	#else
+	#error "No idea what the OS is."
+	#endif
+}
+
+std::string user_path(std::string const &suffix) {
+	static std::string path = get_user_path();
+	return path + "/" + suffix;
+}
@@ -5,6 +5,8 @@
 #include "MeshBuffer.hpp"
 #include "data_path.hpp"
 #include "compile_program.hpp"
+#include "GLState.hpp"
+#include "GPUProfiler.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
@@ -31,8 +33,8 @@ inline float char_spacing(char a, char b) {
 GLint text_program_mvp_mat4 = -1;
 GLint text_program_color_vec4 = -1;
 
-Load< GLuint > text_program(LoadTagInit, [](){
-	GLuint *ret = new GLuint(compile_program(
+Load< GLuint > text_program(LoadTagShaders, [](){
+	GLuint *ret = new GLuint(submit_program(
 		"#version 330\n"
 		"uniform mat4 mvp;\n"
 		"in vec4 Position;\n"
@@ -48,8 +50,11 @@ Load< GLuint > text_program(LoadTagInit, [](){
 		"}\n"
 	));
 
-	text_program_mvp_mat4 = glGetUniformLocation(*ret, "mvp");
-	text_program_color_vec4 = glGetUniformLocation(*ret, "color");
+	add_load_function(LoadTagLink, [ret](){
+		finish_program(*ret);
+		text_program_mvp_mat4 = glGetUniformLocation(*ret, "mvp");
+		text_program_color_vec4 = glGetUniformLocation(*ret, "color");
+	});
 
 	return ret;
 });
@@ -77,8 +82,10 @@ void draw_text(std::string const &text, glm::vec2 const &anchor, float height, g
 }
 
 void draw_text(std::string const &text, glm::mat4 const &transform, glm::vec4 color) {
-	glUseProgram(*text_program);
-	glBindVertexArray(*text_meshes_for_text_program);
+	GPUProfiler::Scope profile("draw_text");
+
+	GLState::use_program(*text_program);
+	GLState::bind_vertex_array(*text_meshes_for_text_program);
 
 	float x = 0.0f;
 	for (uint32_t i = 0; i < text.size(); ++i) {
@@ -91,8 +98,8 @@ void draw_text(std::string const &text, glm::mat4 const &transform, glm::vec4 co
 				glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
 				glm::vec4(s * x, 0.0f, 0.0f, 1.0f)
 			);
-			glUniformMatrix4fv(text_program_mvp_mat4, 1, GL_FALSE, glm::value_ptr(mvp));
-			glUniform4fv(text_program_color_vec4, 1, glm::value_ptr(color));
+			GLState::uniform(text_program_mvp_mat4, mvp);
+			GLState::uniform(text_program_color_vec4, color);
 
 			MeshBuffer::Mesh const &mesh = text_meshes->lookup(text.substr(i,1));
 			glDrawArrays(GL_TRIANGLES, mesh.start, mesh.count);
@@ -100,10 +107,6 @@ void draw_text(std::string const &text, glm::mat4 const &transform, glm::vec4 co
 
 		x += char_width(text[i]);
 	}
-
-
-	glBindVertexArray(0);
-	glUseProgram(0);
 }
 
 float text_width(std::string const &text, float height) {
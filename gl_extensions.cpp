@@ -0,0 +1,43 @@
+#include "gl_extensions.hpp"
+
+#include <SDL.h>
+
+#include <unordered_set>
+
+bool gl_has_version(int major, int minor) {
+	static GLint context_major = -1;
+	static GLint context_minor = -1;
+	if (context_major == -1) {
+		glGetIntegerv(GL_MAJOR_VERSION, &context_major);
+		glGetIntegerv(GL_MINOR_VERSION, &context_minor);
+	}
+	return context_major > major || (context_major == major && context_minor >= minor);
+}
+
+bool gl_has_extension(std::string const &name) {
+	static std::unordered_set< std::string > extensions;
+	static bool fetched = false;
+	if (!fetched) {
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; ++i) {
+			GLubyte const *ext = glGetStringi(GL_EXTENSIONS, GLuint(i));
+			if (ext) extensions.insert(reinterpret_cast< char const * >(ext));
+		}
+		fetched = true;
+	}
+	return extensions.count(name) != 0;
+}
+
+namespace {
+	void *(*proc_address_loader)(char const *) = nullptr;
+}
+
+void *gl_get_proc_address(char const *name) {
+	if (proc_address_loader) return proc_address_loader(name);
+	return SDL_GL_GetProcAddress(name);
+}
+
+void gl_set_proc_address_loader(void *(*loader)(char const *name)) {
+	proc_address_loader = loader;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <string>
+
+//Helpers for OpenGL functionality beyond the 3.3 core profile that GL.hpp guarantees.
+// (only valid after the OpenGL context has been created)
+
+//returns true if the current context is at least OpenGL version 'major.minor':
+bool gl_has_version(int major, int minor);
+
+//returns true if the current context advertises the named extension (e.g. "GL_ARB_get_program_binary"):
+bool gl_has_extension(std::string const &name);
+
+//looks up an entry point by name at runtime; returns nullptr if it isn't available:
+void *gl_get_proc_address(char const *name);
+
+//gl_get_proc_address uses SDL_GL_GetProcAddress unless another loader is set
+// (e.g. for contexts not created through SDL):
+void gl_set_proc_address_loader(void *(*loader)(char const *name));
+
+template< typename PROC >
+PROC gl_get_proc(char const *name) {
+	return reinterpret_cast< PROC >(gl_get_proc_address(name));
+}
@@ -0,0 +1,182 @@
+#include "headless_context.hpp"
+
+#include "gl_extensions.hpp"
+
+#include <iostream>
+
+#if defined(__linux__)
+
+//(EGL is loaded at runtime, so that builds that never run headless don't need libEGL:)
+#define EGL_EGL_PROTOTYPES 0
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <dlfcn.h>
+
+#include <cstring>
+
+namespace {
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLContext context = EGL_NO_CONTEXT;
+
+	//EGL entry points, from libEGL (loaded by load_egl()):
+	void *egl_library = nullptr;
+	PFNEGLGETPROCADDRESSPROC eglGetProcAddress = nullptr;
+	PFNEGLQUERYSTRINGPROC eglQueryString = nullptr;
+	PFNEGLGETDISPLAYPROC eglGetDisplay = nullptr;
+	PFNEGLINITIALIZEPROC eglInitialize = nullptr;
+	PFNEGLTERMINATEPROC eglTerminate = nullptr;
+	PFNEGLGETERRORPROC eglGetError = nullptr;
+	PFNEGLBINDAPIPROC eglBindAPI = nullptr;
+	PFNEGLCHOOSECONFIGPROC eglChooseConfig = nullptr;
+	PFNEGLCREATECONTEXTPROC eglCreateContext = nullptr;
+	PFNEGLDESTROYCONTEXTPROC eglDestroyContext = nullptr;
+	PFNEGLMAKECURRENTPROC eglMakeCurrent = nullptr;
+
+	template< typename PROC >
+	bool load_proc(char const *name, PROC *proc) {
+		*proc = reinterpret_cast< PROC >(dlsym(egl_library, name));
+		if (!*proc) std::cerr << "libEGL is missing '" << name << "'." << std::endl;
+		return *proc != nullptr;
+	}
+
+	//prints a message and returns false if libEGL (or an entry point) is missing:
+	bool load_egl() {
+		if (egl_library) return true;
+		egl_library = dlopen("libEGL.so.1", RTLD_NOW | RTLD_LOCAL);
+		if (!egl_library) {
+			std::cerr << "Error loading libEGL (" << dlerror() << ")." << std::endl;
+			return false;
+		}
+		bool loaded = load_proc("eglGetProcAddress", &eglGetProcAddress)
+			&& load_proc("eglQueryString", &eglQueryString)
+			&& load_proc("eglGetDisplay", &eglGetDisplay)
+			&& load_proc("eglInitialize", &eglInitialize)
+			&& load_proc("eglTerminate", &eglTerminate)
+			&& load_proc("eglGetError", &eglGetError)
+			&& load_proc("eglBindAPI", &eglBindAPI)
+			&& load_proc("eglChooseConfig", &eglChooseConfig)
+			&& load_proc("eglCreateContext", &eglCreateContext)
+			&& load_proc("eglDestroyContext", &eglDestroyContext)
+			&& load_proc("eglMakeCurrent", &eglMakeCurrent);
+		if (!loaded) {
+			dlclose(egl_library);
+			egl_library = nullptr;
+		}
+		return loaded;
+	}
+
+	bool has_egl_extension(EGLDisplay dpy, char const *name) {
+		char const *extensions = eglQueryString(dpy, EGL_EXTENSIONS);
+		if (!extensions) return false;
+		size_t len = std::strlen(name);
+		for (char const *at = std::strstr(extensions, name); at; at = std::strstr(at + 1, name)) {
+			if ((at == extensions || at[-1] == ' ') && (at[len] == ' ' || at[len] == '\0')) return true;
+		}
+		return false;
+	}
+
+	void *egl_proc_address(char const *name) {
+		return reinterpret_cast< void * >(eglGetProcAddress(name));
+	}
+}
+
+bool create_headless_context() {
+	if (!load_egl()) return false;
+
+	//prefer Mesa's surfaceless platform (works without a display server or GPU):
+	if (has_egl_extension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless")) {
+		auto get_platform_display = reinterpret_cast< PFNEGLGETPLATFORMDISPLAYEXTPROC >(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+		if (get_platform_display) {
+			display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		}
+	}
+	if (display == EGL_NO_DISPLAY) {
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	if (display == EGL_NO_DISPLAY) {
+		std::cerr << "Error getting EGL display." << std::endl;
+		return false;
+	}
+
+	EGLint major = 0, minor = 0;
+	if (!eglInitialize(display, &major, &minor)) {
+		std::cerr << "Error initializing EGL (0x" << std::hex << eglGetError() << std::dec << ")." << std::endl;
+		display = EGL_NO_DISPLAY;
+		return false;
+	}
+
+	if (!has_egl_extension(display, "EGL_KHR_surfaceless_context")) {
+		std::cerr << "EGL display doesn't support surfaceless contexts." << std::endl;
+		destroy_headless_context();
+		return false;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		std::cerr << "EGL doesn't support the desktop OpenGL API." << std::endl;
+		destroy_headless_context();
+		return false;
+	}
+
+	EGLConfig config = EGL_NO_CONFIG_KHR;
+	if (!has_egl_extension(display, "EGL_KHR_no_config_context")) {
+		EGLint const config_attribs[] = {
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_NONE
+		};
+		EGLint count = 0;
+		if (!eglChooseConfig(display, config_attribs, &config, 1, &count) || count == 0) {
+			std::cerr << "Error choosing EGL config." << std::endl;
+			destroy_headless_context();
+			return false;
+		}
+	}
+
+	//OpenGL 3.3 core profile, matching the windowed path in main.cpp:
+	EGLint const context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+	if (context == EGL_NO_CONTEXT) {
+		std::cerr << "Error creating EGL context (0x" << std::hex << eglGetError() << std::dec << ")." << std::endl;
+		destroy_headless_context();
+		return false;
+	}
+
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		std::cerr << "Error making EGL context current (0x" << std::hex << eglGetError() << std::dec << ")." << std::endl;
+		destroy_headless_context();
+		return false;
+	}
+
+	//SDL's video subsystem isn't running, so extension entry points come from EGL instead:
+	gl_set_proc_address_loader(egl_proc_address);
+
+	return true;
+}
+
+void destroy_headless_context() {
+	if (display == EGL_NO_DISPLAY) return;
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (context != EGL_NO_CONTEXT) {
+		eglDestroyContext(display, context);
+		context = EGL_NO_CONTEXT;
+	}
+	eglTerminate(display);
+	display = EGL_NO_DISPLAY;
+}
+
+#else //not linux
+
+bool create_headless_context() {
+	std::cerr << "Headless rendering is only supported on Linux (via EGL)." << std::endl;
+	return false;
+}
+
+void destroy_headless_context() {
+}
+
+#endif
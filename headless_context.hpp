@@ -0,0 +1,13 @@
+#pragma once
+
+//An offscreen OpenGL 3.3 core context for running without a window (e.g. frame benchmarks on CI machines).
+// Uses EGL's surfaceless platform, which Mesa also provides in software (llvmpipe), so no GPU is needed.
+// There is no default framebuffer: render into a framebuffer object.
+// Only implemented on Linux; elsewhere create_headless_context() reports an error and returns false.
+// (libEGL is loaded when the context is created, so only headless runs need it installed)
+
+//create the context and make it current; prints a message and returns false on failure:
+bool create_headless_context();
+
+//release the context created above:
+void destroy_headless_context();
@@ -0,0 +1,35 @@
+#include "load_png.hpp"
+
+#include <png.h>
+
+#include <stdexcept>
+#include <cstring>
+#include <cassert>
+
+void load_png(std::string const &filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin) {
+	assert(size);
+	assert(data);
+
+	//uses libpng's "simplified" API, which converts any input format to RGBA:
+	png_image image;
+	std::memset(&image, 0, sizeof(image));
+	image.version = PNG_IMAGE_VERSION;
+
+	if (!png_image_begin_read_from_file(&image, filename.c_str())) {
+		throw std::runtime_error("Failed to read png '" + filename + "': " + image.message);
+	}
+	image.format = PNG_FORMAT_RGBA;
+
+	std::vector< glm::u8vec4 > pixels(image.width * image.height);
+	//negative row stride stores the bottom row first:
+	png_int_32 stride = png_int_32(image.width * 4);
+	if (origin == LowerLeftOrigin) stride = -stride;
+	if (!png_image_finish_read(&image, nullptr, pixels.data(), stride, nullptr)) {
+		std::string message = image.message;
+		png_image_free(&image);
+		throw std::runtime_error("Failed to decode png '" + filename + "': " + message);
+	}
+
+	*size = glm::uvec2(image.width, image.height);
+	*data = std::move(pixels);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+//load_png reads an RGBA image from a .png file:
+// note: will throw on failure.
+// note: doesn't touch OpenGL, so it is safe to call from any thread.
+enum OriginLocation {
+	LowerLeftOrigin, //first pixel of data is the lower left (as OpenGL expects)
+	UpperLeftOrigin, //first pixel of data is the upper left (as stored in the file)
+};
+void load_png(std::string const &filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin);
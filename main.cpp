@@ -6,6 +6,7 @@
 
 //The 'GameMode' mode plays the game:
 #include "GameMode.hpp"
+#include "CratesMode.hpp"
 #include "NowYouHearMeMode.hpp"
 
 //The 'Sound' header has functions for managing sound:
@@ -14,6 +15,29 @@
 //GL.hpp will include a non-namespace-polluting set of opengl prototypes:
 #include "GL.hpp"
 
+//GLState shadows OpenGL state to avoid redundant calls:
+#include "GLState.hpp"
+
+//GPUProfiler times named scopes on the CPU and GPU:
+#include "GPUProfiler.hpp"
+
+//StreamBuffer holds per-frame vertex data; its frames are fenced after drawing:
+#include "StreamBuffer.hpp"
+
+//DynamicResolution scales scene rendering to keep frame times on budget:
+#include "DynamicResolution.hpp"
+//FrameGraph pools render targets between frames, and frees the ones that go unused:
+#include "FrameGraph.hpp"
+
+//TextureCache decodes textures in the background and uploads them a few per frame:
+#include "TextureCache.hpp"
+
+//Jobs runs work on every core; frame jobs and main-thread work are finished at the end of each frame:
+#include "Jobs.hpp"
+
+//headless_context creates an OpenGL context without a window (for benchmarking):
+#include "headless_context.hpp"
+
 //Includes for libSDL:
 #include <SDL.h>
 
@@ -29,14 +53,95 @@
 #include <fstream>
 #include <memory>
 #include <algorithm>
+#include <vector>
+#include <array>
+#include <cstdio>
+
+//options for running a fixed number of frames without a window:
+struct HeadlessOptions {
+	bool enabled = false;
+	uint32_t frames = 600; //frames to render
+	uint32_t dump_every = 0; //write every n'th frame to an image (0 == never)
+	std::string dump_prefix = "frame"; //images are written to '<dump_prefix>-<frame>.ppm'
+	std::string timings; //per-frame timings are written here as CSV (empty == stdout)
+};
+
+//create a mode by name ("nyhm", "crates", or "game"):
+static std::shared_ptr< Mode > make_mode(std::string const &name) {
+	if (name == "nyhm") return std::make_shared< NowYouHearMe::NowYouHearMeMode >();
+	if (name == "crates") return std::make_shared< CratesMode >();
+	if (name == "game") return std::make_shared< GameMode >();
+	throw std::runtime_error("Unknown mode '" + name + "' (expecting 'nyhm', 'crates', or 'game').");
+}
+
+static int run_headless(HeadlessOptions const &options, std::string const &mode_name, glm::uvec2 const &size);
 
 int main(int argc, char **argv) {
 	struct {
 		//TODO: this is where you set the title and size of your game window
 		std::string title = "Now You Hear Me";
 		glm::uvec2 size = glm::uvec2(640, 400);
+		std::string mode = "nyhm";
+		bool pipelined = false; //update the next frame while drawing this one (for modes that support it)
 	} config;
 
+	//------------  command line ------------
+
+	HeadlessOptions headless;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		auto next = [&]() -> std::string {
+			if (i + 1 >= argc) {
+				std::cerr << "Option '" << arg << "' expects a value." << std::endl;
+				exit(1);
+			}
+			return argv[++i];
+		};
+		if (arg == "--headless") {
+			headless.enabled = true;
+		} else if (arg == "--frames") {
+			headless.frames = uint32_t(std::stoul(next()));
+		} else if (arg == "--dump-every") {
+			headless.dump_every = uint32_t(std::stoul(next()));
+		} else if (arg == "--dump-prefix") {
+			headless.dump_prefix = next();
+		} else if (arg == "--timings") {
+			headless.timings = next();
+		} else if (arg == "--mode") {
+			config.mode = next();
+		} else if (arg == "--size") {
+			std::string size = next();
+			unsigned int w = 0, h = 0;
+			if (std::sscanf(size.c_str(), "%ux%u", &w, &h) != 2 || w == 0 || h == 0) {
+				std::cerr << "Expecting --size WIDTHxHEIGHT, got '" << size << "'." << std::endl;
+				return 1;
+			}
+			config.size = glm::uvec2(w, h);
+		} else if (arg == "--pipelined") {
+			config.pipelined = true;
+		} else if (arg == "--dynamic-resolution") {
+			DynamicResolution::settings.enabled = true;
+		} else if (arg == "--target-ms") {
+			DynamicResolution::settings.target_ms = std::stof(next());
+		} else if (arg == "--min-scale") {
+			DynamicResolution::settings.min_scale = std::stof(next());
+		} else {
+			std::cerr << "Usage:\n"
+				"  " << argv[0] << " [--mode nyhm|crates|game] [--size WxH] [--pipelined] [--dynamic-resolution [--target-ms MS] [--min-scale S]]\n"
+				"  " << argv[0] << " --headless [--frames N] [--dump-every K] [--dump-prefix PATH] [--timings FILE] [--mode ...] [--size WxH] [--dynamic-resolution ...]\n";
+			return 1;
+		}
+	}
+
+	//start worker threads (used by modes, scene updates, and texture decoding):
+	Jobs::init();
+
+	if (headless.enabled) {
+		int ret = run_headless(headless, config.mode, config.size);
+		Jobs::shutdown();
+		return ret;
+	}
+
 	//------------  initialization ------------
 
 	//Initialize SDL library:
@@ -106,7 +211,7 @@ int main(int argc, char **argv) {
 
 	//------------ create game mode + make current --------------
 
-	Mode::set_current(std::make_shared< NowYouHearMe::NowYouHearMeMode >());
+	Mode::set_current(make_mode(config.mode));
 
 	//------------ main loop ------------
 
@@ -122,15 +227,27 @@ int main(int argc, char **argv) {
 		window_size = glm::uvec2(w, h);
 		SDL_GL_GetDrawableSize(window, &w, &h);
 		drawable_size = glm::uvec2(w, h);
-		glViewport(0, 0, drawable_size.x, drawable_size.y);
+		GLState::viewport(0, 0, drawable_size.x, drawable_size.y);
 	};
 	on_resize();
 
+	//F3 toggles an on-screen GPU/CPU timing readout:
+	bool show_profiler = false;
+
+	//with --pipelined (and a mode that supports it), a job updates the mode and extracts
+	// the next frame's snapshot while the main thread draws the previous snapshot:
+	Jobs::Group simulation;
+	std::shared_ptr< Mode > extracted; //mode being drawn pipelined (null if none)
+	uint32_t slot = 0; //snapshot being extracted (the other one is being drawn)
+
 	//This will loop until the current mode is set to null:
 	while (Mode::current) {
 		//every pass through the game loop creates one frame of output
 		//  by performing three steps:
 
+		GLState::begin_frame();
+		auto frame_start = std::chrono::high_resolution_clock::now();
+
 		{ //(1) process any events that are pending
 			static SDL_Event evt;
 			while (SDL_PollEvent(&evt) == 1) {
@@ -139,7 +256,9 @@ int main(int argc, char **argv) {
 					on_resize();
 				}
 				//handle input:
-				if (Mode::current && Mode::current->handle_event(evt, window_size)) {
+				if (evt.type == SDL_KEYDOWN && evt.key.keysym.scancode == SDL_SCANCODE_F3) {
+					show_profiler = !show_profiler;
+				} else if (Mode::current && Mode::current->handle_event(evt, window_size)) {
 					// mode handled it; great
 				} else if (evt.type == SDL_QUIT) {
 					Mode::set_current(nullptr);
@@ -159,28 +278,78 @@ int main(int argc, char **argv) {
 			//lag to avoid spiral of death:
 			elapsed = std::min(0.1f, elapsed);
 
-			Mode::current->update(elapsed);
-			if (!Mode::current) break;
+			if (config.pipelined && Mode::current->pipelined()) {
+				std::shared_ptr< Mode > mode = Mode::current;
+				//(a mode that wasn't drawn pipelined last frame needs a snapshot of its current state)
+				if (extracted != mode) {
+					mode->extract(slot, drawable_size, true);
+					extracted = mode;
+				}
+				slot ^= 1;
+				//(the main thread only calls draw_snapshot() on the other slot until 'simulation' is done)
+				uint32_t extract_slot = slot;
+				glm::uvec2 extract_size = drawable_size;
+				Jobs::run([mode, elapsed, extract_slot, extract_size](){
+					mode->update(elapsed);
+					mode->extract(extract_slot, extract_size, true); //(update can't change Mode::current)
+				}, &simulation);
+			} else {
+				extracted.reset();
+				Mode::current->update(elapsed);
+				if (!Mode::current) break;
+			}
+
+			//upload any textures that finished decoding (spending at most a couple of milliseconds):
+			TextureCache::update(2.0f);
 		}
 
 		{ //(3) call the current mode's "draw" function to produce output:
+			GPUProfiler::begin_frame();
+
 			//clear the depth+color buffers and set some default state:
-			glClearColor(0.5, 0.5, 0.5, 0.0);
+			GLState::clear_color(glm::vec4(0.5f, 0.5f, 0.5f, 0.0f));
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glEnable(GL_DEPTH_TEST);
-			glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			GLState::enable(GL_DEPTH_TEST);
+			GLState::enable(GL_BLEND);
+			GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+			if (extracted) {
+				extracted->draw_snapshot(slot ^ 1, drawable_size);
+			} else {
+				Mode::current->draw(drawable_size);
+			}
 
-			Mode::current->draw(drawable_size);
+			//finish jobs started this frame (and run the main-thread work they queued):
+			Jobs::end_frame();
+
+			if (show_profiler) GPUProfiler::draw_readout(drawable_size);
+
+			GPUProfiler::end_frame();
+			StreamBuffer::end_frame();
+			FrameGraph::end_frame();
+		}
+
+		{ //report this frame's CPU time (not counting the wait for vsync) and the latest GPU time for dynamic resolution:
+			float cpu_ms = std::chrono::duration< float, std::milli >(std::chrono::high_resolution_clock::now() - frame_start).count();
+			float gpu_ms = 0.0f;
+			GPUProfiler::latest("frame", &gpu_ms, nullptr);
+			DynamicResolution::frame_finished(cpu_ms, gpu_ms);
 		}
 
 		//Finally, wait until the recently-drawn frame is shown before doing it all again:
 		SDL_GL_SwapWindow(window);
+
+		//the next frame's events may change the mode, so its update must be done:
+		simulation.wait();
 	}
 
 
 	//------------  teardown ------------
 
+	Jobs::shutdown();
+
+	GPUProfiler::shutdown();
+
 	SDL_GL_DeleteContext(context);
 	context = 0;
 
@@ -189,3 +358,225 @@ int main(int argc, char **argv) {
 
 	return 0;
 }
+
+//------------ headless benchmarking ------------
+
+//The scripted input used for headless runs: grab the mouse, walk forward for the first half
+// of the run and backward for the second, while turning one full circle:
+static std::vector< SDL_Event > scripted_input(uint32_t frame, uint32_t frames, glm::uvec2 const &size) {
+	std::vector< SDL_Event > events;
+	auto key = [&](Uint32 type, SDL_Scancode scancode) {
+		SDL_Event evt;
+		SDL_zero(evt);
+		evt.type = type;
+		evt.key.state = (type == SDL_KEYDOWN ? SDL_PRESSED : SDL_RELEASED);
+		evt.key.keysym.scancode = scancode;
+		events.emplace_back(evt);
+	};
+
+	if (frame == 0) {
+		SDL_Event evt;
+		SDL_zero(evt);
+		evt.type = SDL_MOUSEBUTTONDOWN;
+		evt.button.button = SDL_BUTTON_LEFT;
+		evt.button.state = SDL_PRESSED;
+		events.emplace_back(evt);
+		key(SDL_KEYDOWN, SDL_SCANCODE_W);
+	}
+	if (frame == frames / 2) {
+		key(SDL_KEYUP, SDL_SCANCODE_W);
+		key(SDL_KEYDOWN, SDL_SCANCODE_S);
+	}
+
+	{ //turn (modes convert mouse motion to radians as xrel / window height * fovy; assume a 60 degree fovy):
+		float const fovy = 60.0f / 180.0f * 3.1415926f;
+		auto turn_at = [&](uint32_t f) {
+			return int32_t(std::floor(2.0f * 3.1415926f * (f / float(frames)) / fovy * size.y));
+		};
+		SDL_Event evt;
+		SDL_zero(evt);
+		evt.type = SDL_MOUSEMOTION;
+		evt.motion.xrel = turn_at(frame + 1) - turn_at(frame);
+		events.emplace_back(evt);
+	}
+	return events;
+}
+
+//write the currently-bound read framebuffer to a binary PPM:
+static void dump_frame(std::string const &filename, glm::uvec2 const &size) {
+	std::vector< uint8_t > pixels(size.x * size.y * 4);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+	std::ofstream out(filename, std::ios::binary);
+	out << "P6\n" << size.x << " " << size.y << "\n255\n";
+	std::vector< uint8_t > row(size.x * 3);
+	for (uint32_t y = size.y - 1; y < size.y; --y) { //OpenGL rows are bottom-to-top
+		for (uint32_t x = 0; x < size.x; ++x) {
+			row[3*x+0] = pixels[4*(y*size.x+x)+0];
+			row[3*x+1] = pixels[4*(y*size.x+x)+1];
+			row[3*x+2] = pixels[4*(y*size.x+x)+2];
+		}
+		out.write(reinterpret_cast< char const * >(row.data()), row.size());
+	}
+	if (!out) {
+		std::cerr << "WARNING: failed to write '" << filename << "'." << std::endl;
+	}
+}
+
+//Runs 'mode_name' for a fixed number of frames at a fixed timestep, rendering into an offscreen
+// framebuffer (no window, no vsync, no audio output), and reports per-frame CPU and GPU times:
+static int run_headless(HeadlessOptions const &options, std::string const &mode_name, glm::uvec2 const &size) {
+	if (!create_headless_context()) {
+		return 1;
+	}
+
+	//------------ offscreen render target ------------
+	GLuint framebuffer = 0;
+	GLuint color_renderbuffer = 0;
+	GLuint depth_renderbuffer = 0;
+	glGenRenderbuffers(1, &color_renderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, color_renderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x, size.y);
+	glGenRenderbuffers(1, &depth_renderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, size.x, size.y);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_renderbuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "Error creating offscreen framebuffer." << std::endl;
+		destroy_headless_context();
+		return 1;
+	}
+	GLState::viewport(0, 0, size.x, size.y);
+
+	//------------ load assets + create mode ------------
+	call_load_functions();
+	Mode::set_current(make_mode(mode_name));
+
+	//------------ main loop ------------
+
+	//GPU timings are read a few frames late so that waiting on results doesn't stall the pipeline:
+	std::array< GLuint, 4 > queries;
+	glGenQueries(GLsizei(queries.size()), queries.data());
+
+	std::vector< float > cpu_ms;
+	std::vector< float > gpu_ms;
+	cpu_ms.reserve(options.frames);
+	gpu_ms.reserve(options.frames);
+	auto read_query = [&](uint32_t frame) {
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(queries[frame % queries.size()], GL_QUERY_RESULT, &ns);
+		gpu_ms[frame] = float(ns / 1.0e6);
+	};
+
+	float const elapsed = 1.0f / 60.0f; //fixed timestep, so runs are repeatable
+
+	uint32_t frame = 0;
+	for (; frame < options.frames && Mode::current; ++frame) {
+		GLState::begin_frame();
+
+		auto before = std::chrono::high_resolution_clock::now();
+
+		for (auto const &evt : scripted_input(frame, options.frames, size)) {
+			if (Mode::current) Mode::current->handle_event(evt, size);
+		}
+		if (!Mode::current) break;
+
+		Mode::current->update(elapsed);
+		if (!Mode::current) break;
+		TextureCache::update(2.0f);
+
+		glBeginQuery(GL_TIME_ELAPSED, queries[frame % queries.size()]);
+		GPUProfiler::begin_frame();
+		GLState::clear_color(glm::vec4(0.5f, 0.5f, 0.5f, 0.0f));
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		GLState::enable(GL_DEPTH_TEST);
+		GLState::enable(GL_BLEND);
+		GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		Mode::current->draw(size);
+		Jobs::end_frame();
+		GPUProfiler::end_frame();
+		StreamBuffer::end_frame();
+		FrameGraph::end_frame();
+		glEndQuery(GL_TIME_ELAPSED);
+		glFlush();
+
+		auto after = std::chrono::high_resolution_clock::now();
+		cpu_ms.emplace_back(std::chrono::duration< float, std::milli >(after - before).count());
+		gpu_ms.emplace_back(0.0f);
+
+		{
+			float latest_gpu_ms = 0.0f;
+			GPUProfiler::latest("frame", &latest_gpu_ms, nullptr);
+			DynamicResolution::frame_finished(cpu_ms.back(), latest_gpu_ms);
+		}
+
+		if (frame + 1 >= queries.size()) {
+			read_query(frame + 1 - uint32_t(queries.size()));
+		}
+
+		if (options.dump_every != 0 && frame % options.dump_every == 0) {
+			char suffix[32];
+			std::snprintf(suffix, sizeof(suffix), "-%05u.ppm", (unsigned)frame);
+			dump_frame(options.dump_prefix + suffix, size);
+		}
+	}
+	//read timings for the last few frames:
+	for (uint32_t f = (frame >= queries.size() ? frame + 1 - uint32_t(queries.size()) : 0); f < frame; ++f) {
+		read_query(f);
+	}
+
+	//------------ report ------------
+	{
+		std::ofstream timings_file;
+		if (!options.timings.empty()) {
+			timings_file.open(options.timings);
+			if (!timings_file) std::cerr << "WARNING: failed to open '" << options.timings << "'; writing timings to stdout." << std::endl;
+		}
+		std::ostream &out = (timings_file.is_open() ? timings_file : std::cout);
+		out << "frame,cpu_ms,gpu_ms\n";
+		for (uint32_t f = 0; f < frame; ++f) {
+			out << f << "," << cpu_ms[f] << "," << gpu_ms[f] << "\n";
+		}
+		out.flush();
+
+		auto summarize = [&](char const *name, std::vector< float > ms) {
+			if (ms.empty()) return;
+			std::sort(ms.begin(), ms.end());
+			float total = 0.0f;
+			for (float m : ms) total += m;
+			std::cerr << name << ": mean " << total / ms.size() << " ms, median " << ms[ms.size() / 2]
+				<< " ms, 99th percentile " << ms[std::min(ms.size() - 1, ms.size() * 99 / 100)]
+				<< " ms, max " << ms.back() << " ms" << std::endl;
+		};
+		std::cerr << "Rendered " << frame << " frames of '" << mode_name << "' at " << size.x << "x" << size.y << "." << std::endl;
+		summarize("CPU", cpu_ms);
+		summarize("GPU", gpu_ms);
+
+		//per-scope breakdown (rolling window over the last frames of the run):
+		for (auto const &stats : GPUProfiler::report()) {
+			std::cerr << "  " << std::string(2 * stats.depth, ' ') << stats.name
+				<< ": GPU mean " << stats.gpu.mean << " ms (p95 " << stats.gpu.p95 << ")"
+				<< ", CPU mean " << stats.cpu.mean << " ms (p95 " << stats.cpu.p95 << ")" << std::endl;
+		}
+	}
+
+	//------------  teardown ------------
+	Mode::set_current(nullptr);
+
+	glDeleteQueries(GLsizei(queries.size()), queries.data());
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &color_renderbuffer);
+	glDeleteRenderbuffers(1, &depth_renderbuffer);
+
+	GPUProfiler::shutdown();
+
+	destroy_headless_context();
+
+	return 0;
+}